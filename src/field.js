@@ -574,16 +574,31 @@ export class Field {
       this.metrics.tunnelDepth = skip;
       
       // fast-forward prophecy: manifest multiple times ahead
+      const fakeAngles = [];
+      const fakeToks = [];
       for (let k = 0; k < skip; k++) {
         const fakeAngle = pa + (Math.random() * 2 - 1) * 0.12;
-        const fakeTok = this._positionToken(
+        fakeAngles.push(fakeAngle);
+        fakeToks.push(this._positionToken(
           px + Math.cos(fakeAngle) * (k + 1), 
           py + Math.sin(fakeAngle) * (k + 1), 
           fakeAngle
-        );
-        this._pushCtx(fakeTok);
-        const o2 = this.model.forward(this.ctx);
-        this._manifestAheadStrip(px, py, fakeAngle, o2.probs, k + 1);
+        ));
+      }
+
+      if (this.model.tunnelForward) {
+        // native lung: the whole burst is one call
+        const outs = this.model.tunnelForward(this.ctx, fakeToks);
+        for (let k = 0; k < skip; k++) {
+          this._pushCtx(fakeToks[k]);
+          this._manifestAheadStrip(px, py, fakeAngles[k], outs[k].probs, k + 1);
+        }
+      } else {
+        for (let k = 0; k < skip; k++) {
+          this._pushCtx(fakeToks[k]);
+          const o2 = this.model.forward(this.ctx);
+          this._manifestAheadStrip(px, py, fakeAngles[k], o2.probs, k + 1);
+        }
       }
       
       // hard jolt in debt (the field "hurts")
@@ -18,48 +18,67 @@
 // "Who am I and how do I speak?" — inner voice modulation
 // ═══════════════════════════════════════════════════════════════════════════════
 
-// GPT-style weight layout (approximate for 10M params):
-// - wte: token embeddings [vocab × d_model]
+// GPT-2 layout, read from the file header (voice_load in body.c):
+// - wte: token embeddings [vocab × d_model] (also the output projection)
 // - wpe: position embeddings [ctx × d_model]
-// - Blocks × n_layers: (attn + mlp)
+// - Blocks × n_layers: (layernorm, causal attention, layernorm, MLP)
+// The values below are what personality_brain.bin carries.
 const PERSONALITY_CONFIG = {
-  vocabSize: 185,        // char-level from vocab_personality.bin
-  dModel: 256,           // hidden dimension
+  vocabSize: 82,         // char-level from vocab_personality.bin
+  dModel: 384,           // hidden dimension
   nLayers: 6,            // transformer blocks
-  nHeads: 4,             // attention heads
-  ctxLen: 512,           // context length
+  nHeads: 6,             // attention heads
+  ctxLen: 256,           // context length
+  ffDim: 1536,           // MLP hidden dimension
 };
 
 export class PersonalityLoader {
   constructor() {
-    this.weights = null;
-    this.vocab = null;
+    this.vocab = null;           // token id → character
     this.config = PERSONALITY_CONFIG;
     this.loaded = false;
 
-    // Extracted weight tensors
-    this.tokenEmbed = null;      // [vocab × d_model]
-    this.posEmbed = null;        // [ctx × d_model]
-    this.attentionBias = null;   // aggregated attention bias
+    this._module = null;
+    this._voice = 0;             // AriannaVoice* (runs the whole stack in WASM)
+    this._tokensPtr = 0;         // ctxLen int32 staging buffer
+    this.tokenEmbed = null;      // [vocab × d_model] copy of wte
   }
 
   async load(weightsPath = './weights/personality_brain.bin', vocabPath = './weights/vocab_personality.bin') {
     try {
-      // Load vocab (char-level)
+      const module = await loadWASM();
+      if (!module) throw new Error('WASM body not available');
+
+      // Load vocab: int32 count, then (uint8 length, UTF-8 bytes) per token
       const vocabResp = await fetch(vocabPath);
       if (!vocabResp.ok) throw new Error(`Vocab fetch failed: ${vocabResp.status}`);
-      this.vocab = await vocabResp.text();
+      this.vocab = this._parseVocab(await vocabResp.arrayBuffer());
       console.log(`🧠 Personality vocab: ${this.vocab.length} chars`);
 
-      // Load binary weights
+      // Load binary weights straight into the voice (no JS-side pass over them)
       const weightsResp = await fetch(weightsPath);
       if (!weightsResp.ok) throw new Error(`Weights fetch failed: ${weightsResp.status}`);
       const buffer = await weightsResp.arrayBuffer();
-      this.weights = new Float32Array(buffer);
-      console.log(`🧠 Personality weights: ${this.weights.length} floats (${(buffer.byteLength / 1024 / 1024).toFixed(1)}MB)`);
-
-      // Extract key tensors
-      this._extractTensors();
+      const staging = module._malloc(buffer.byteLength);
+      module.HEAPU8.set(new Uint8Array(buffer), staging);
+      const voice = module._voice_load(staging, buffer.byteLength);
+      module._free(staging);
+      if (!voice) throw new Error('Unsupported personality weight layout');
+      console.log(`🧠 Personality weights: ${(buffer.byteLength / 1024 / 1024).toFixed(1)}MB`);
+
+      this._module = module;
+      this._voice = voice;
+      this.config = {
+        vocabSize: module._voice_get_vocab_size(voice),
+        dModel: module._voice_get_d_model(voice),
+        nLayers: module._voice_get_n_layers(voice),
+        nHeads: module._voice_get_n_heads(voice),
+        ctxLen: module._voice_get_ctx_len(voice),
+        ffDim: PERSONALITY_CONFIG.ffDim,
+      };
+      const { vocabSize, dModel, ctxLen } = this.config;
+      this._tokensPtr = module._malloc(ctxLen * 4);
+      this.tokenEmbed = new Float32Array(module.HEAPF32.buffer, module._voice_get_embeddings(voice), vocabSize * dModel).slice();
 
       this.loaded = true;
       console.log('🧠 Personality loaded: "Who am I and how do I speak?"');
@@ -70,41 +89,46 @@ export class PersonalityLoader {
     }
   }
 
-  _extractTensors() {
-    const { vocabSize, dModel, ctxLen } = this.config;
-    let offset = 0;
-
-    // Token embeddings: first vocabSize × dModel floats
-    const wteSize = vocabSize * dModel;
-    this.tokenEmbed = this.weights.slice(offset, offset + wteSize);
-    offset += wteSize;
-
-    // Position embeddings: next ctxLen × dModel floats
-    const wpeSize = ctxLen * dModel;
-    if (offset + wpeSize <= this.weights.length) {
-      this.posEmbed = this.weights.slice(offset, offset + wpeSize);
-      offset += wpeSize;
+  _parseVocab(buffer) {
+    const view = new DataView(buffer);
+    const bytes = new Uint8Array(buffer);
+    const decoder = new TextDecoder();
+    const count = view.getInt32(0, true);
+    const vocab = [];
+    let offset = 4;
+    for (let i = 0; i < count; i++) {
+      const len = bytes[offset++];
+      vocab.push(decoder.decode(bytes.subarray(offset, offset + len)));
+      offset += len;
     }
+    return vocab;
+  }
 
-    // Aggregate remaining as attention bias signal
-    // (simplified: we'll use the mean activation pattern)
-    if (offset < this.weights.length) {
-      const remaining = this.weights.slice(offset);
-      this.attentionBias = new Float32Array(dModel);
-
-      // Compute mean activation per dimension
-      const numVectors = Math.floor(remaining.length / dModel);
-      for (let i = 0; i < numVectors; i++) {
-        for (let d = 0; d < dModel; d++) {
-          this.attentionBias[d] += remaining[i * dModel + d];
-        }
-      }
-      for (let d = 0; d < dModel; d++) {
-        this.attentionBias[d] /= numVectors;
-      }
+  // Characters the vocab knows, as token ids (unknown ones are dropped)
+  _encode(text) {
+    const ids = [];
+    for (const char of text) {
+      const idx = this.vocab.indexOf(char);
+      if (idx >= 0) ids.push(idx);
     }
+    return ids;
+  }
 
-    console.log(`🧠 Extracted: tokenEmbed[${this.tokenEmbed?.length}], posEmbed[${this.posEmbed?.length}], attentionBias[${this.attentionBias?.length}]`);
+  /**
+   * Let the inner voice read a text (its tail, up to ctxLen chars)
+   * @param {string} text
+   * @returns {Float32Array} next-character logits, or null
+   */
+  listen(text) {
+    if (!this.loaded) return null;
+    const ids = this._encode(text).slice(-this.config.ctxLen);
+    if (ids.length === 0) return null;
+
+    this._module._voice_reset(this._voice);
+    this._module.HEAP32.set(ids, this._tokensPtr >> 2);
+    const ptr = this._module._voice_feed(this._voice, this._tokensPtr, ids.length);
+    if (!ptr) return null;
+    return new Float32Array(this._module.HEAPF32.buffer, ptr, this.config.vocabSize).slice();
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
@@ -162,28 +186,33 @@ export class PersonalityLoader {
    * Apply personality delta to model logits
    * Stanley-style: personality changes WHERE attention goes, not WHAT model knows
    *
+   * The voice reads the context; the more certain it is of what comes next
+   * (low entropy), the sharper the model's logits become.
+   *
    * @param {Float32Array} logits - model output logits
    * @param {string} context - recent context text
    * @param {number} scale - delta scale (0-1)
    * @returns {Float32Array} modified logits
    */
   applyDelta(logits, context, scale = 0.1) {
-    if (!this.loaded || !this.attentionBias) return logits;
-
-    // Get personality response to context
-    const contextBias = this.getTextBias(context);
-    if (!contextBias) return logits;
-
-    // Compute dot product with attention bias → personality "agreement"
-    let agreement = 0;
-    for (let d = 0; d < this.config.dModel; d++) {
-      agreement += contextBias[d] * this.attentionBias[d];
-    }
-
-    // Normalize and apply as softmax temperature modulation
-    const tempMod = 1.0 + agreement * scale;
-
-    // Apply to logits (multiplicative, not additive)
+    const voiceLogits = this.listen(context);
+    if (!voiceLogits) return logits;
+
+    // Confidence of the inner voice: 1 - H(p) / log(V)
+    const n = voiceLogits.length;
+    let max = -Infinity;
+    for (let i = 0; i < n; i++) max = Math.max(max, voiceLogits[i]);
+    let sum = 0;
+    for (let i = 0; i < n; i++) sum += Math.exp(voiceLogits[i] - max);
+    let entropy = 0;
+    for (let i = 0; i < n; i++) {
+      const p = Math.exp(voiceLogits[i] - max) / sum;
+      if (p > 1e-12) entropy -= p * Math.log(p);
+    }
+    const confidence = 1 - entropy / Math.log(n);
+
+    // Apply as softmax temperature modulation (multiplicative, not additive)
+    const tempMod = 1.0 + confidence * scale;
     const modifiedLogits = new Float32Array(logits.length);
     for (let i = 0; i < logits.length; i++) {
       modifiedLogits[i] = logits[i] * tempMod;
@@ -195,36 +224,19 @@ export class PersonalityLoader {
   /**
    * Generate a "thought" from personality (for wall text)
    * @param {number} length - approximate length
+   * @param {string} prompt - what the voice starts from
+   * @param {number} temperature - 0 = greedy
    * @returns {string} generated philosophical fragment
    */
-  sampleThought(length = 20) {
-    if (!this.loaded || !this.vocab) return '';
-
-    // Simple sampling from token embeddings
-    // Higher magnitude embeddings → more "characteristic" chars
-    const magnitudes = [];
-    const { vocabSize, dModel } = this.config;
-
-    for (let i = 0; i < vocabSize; i++) {
-      let mag = 0;
-      for (let d = 0; d < dModel; d++) {
-        const val = this.tokenEmbed[i * dModel + d];
-        mag += val * val;
-      }
-      magnitudes.push({ idx: i, mag: Math.sqrt(mag) });
-    }
+  sampleThought(length = 20, prompt = '\n', temperature = 0.8) {
+    if (!this.listen(prompt)) return '';
 
-    // Sort by magnitude (higher = more personality-defining)
-    magnitudes.sort((a, b) => b.mag - a.mag);
-
-    // Sample from top chars with some randomness
+    const steps = Math.min(length, this.config.ctxLen);
+    const n = this._module._voice_generate(this._voice, steps, temperature, this._tokensPtr);
     let thought = '';
-    for (let i = 0; i < length; i++) {
-      const topK = Math.min(20, magnitudes.length);
-      const pick = magnitudes[Math.floor(Math.random() * topK)];
-      thought += this.vocab[pick.idx] || ' ';
+    for (let i = 0; i < n; i++) {
+      thought += this.vocab[this._module.HEAP32[(this._tokensPtr >> 2) + i]] || ' ';
     }
-
     return thought;
   }
 }
@@ -239,6 +251,10 @@ export const personality = new PersonalityLoader();
 let wasmModule = null;
 let wasmLoadPromise = null;
 
+// Decoding modes for _lung_prophesy (mirror body.c)
+const LUNG_PROPHESY_GREEDY = 0;
+const LUNG_PROPHESY_SAMPLE = 1;
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // WASM MODULE LOADER
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -282,11 +298,14 @@ export class AriannaLungWASM {
     this.d = config.dModel;
     this.ctx = config.ctx;
     this.nHeads = config.nHeads;
+    this.nKvHeads = config.nKvHeads ?? config.nHeads;
     this.headDim = Math.floor(config.dModel / config.nHeads);
 
     // Buffers for passing data to WASM
     this._contextPtr = null;
     this._topKPtr = null;
+    this._rolloutPtr = null;     // prophecy/tunnel outputs
+    this._rolloutBytes = 0;
 
     // Cache for JS-side access
     this.lastLogits = null;
@@ -298,6 +317,7 @@ export class AriannaLungWASM {
     this.attendSpread = 0.20;
     this.temporalAlpha = 0.5;
     this.useRTLPositions = false;
+    this.useRotaryPositions = false;  // true = rotary (relative) positions
     this.temporalMode = 'symmetric';
 
     // Presence decay (for API compatibility)
@@ -312,7 +332,9 @@ export class AriannaLungWASM {
   // STATIC FACTORY — async creation
   // ─────────────────────────────────────────────────────────────────────────────
 
-  static async create({ vocabSize, dModel = 32, ctx = 16, nHeads = 2, seed = null }) {
+  // nKvHeads < nHeads: grouped-query attention (nHeads a multiple of nKvHeads;
+  // 1 = multi-query) — fewer K/V projections and a smaller K/V cache
+  static async create({ vocabSize, dModel = 32, ctx = 16, nHeads = 2, nKvHeads = nHeads, seed = null }) {
     const module = await loadWASM();
     if (!module) {
       throw new Error('WASM module not available');
@@ -324,12 +346,14 @@ export class AriannaLungWASM {
     }
 
     // Create lung instance in WASM
-    const ptr = module._lung_create(vocabSize, dModel, ctx, nHeads);
+    const ptr = (nKvHeads === nHeads)
+      ? module._lung_create(vocabSize, dModel, ctx, nHeads)
+      : module._lung_create_ex(vocabSize, dModel, ctx, nHeads, nKvHeads);
     if (!ptr) {
       throw new Error('Failed to create AriannaLung in WASM');
     }
 
-    return new AriannaLungWASM(ptr, module, { vocabSize, dModel, ctx, nHeads });
+    return new AriannaLungWASM(ptr, module, { vocabSize, dModel, ctx, nHeads, nKvHeads });
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
@@ -345,7 +369,15 @@ export class AriannaLungWASM {
       this._module._free(this._topKPtr);
       this._topKPtr = null;
     }
+    if (this._rolloutPtr) {
+      this._module._free(this._rolloutPtr);
+      this._rolloutPtr = null;
+      this._rolloutBytes = 0;
+    }
+    this._resonance = null;
+    this._presenceAccum = null;
     if (this._ptr) {
+      this._module._lung_pipeline_wait(this._ptr);
       this._module._lung_destroy(this._ptr);
       this._ptr = null;
     }
@@ -358,17 +390,7 @@ export class AriannaLungWASM {
   forward(ctxIds) {
     if (!this._ptr) throw new Error('Lung destroyed');
 
-    const ids = this._padOrTrim(ctxIds, this.ctx);
-
-    // Allocate context buffer if needed
-    if (!this._contextPtr) {
-      this._contextPtr = this._module._malloc(this.ctx * 4);  // int32
-    }
-
-    // Copy context to WASM memory
-    for (let i = 0; i < this.ctx; i++) {
-      this._module.setValue(this._contextPtr + i * 4, ids[i], 'i32');
-    }
+    const ids = this._writeContext(ctxIds);
 
     // Call forward pass
     const entropy = this._module._lung_forward(this._ptr, this._contextPtr, ids.length);
@@ -396,6 +418,33 @@ export class AriannaLungWASM {
     };
   }
 
+  // Pad/trim to ctx and copy into the WASM context buffer
+  _writeContext(ctxIds) {
+    const ids = this._padOrTrim(ctxIds, this.ctx);
+
+    // Allocate context buffer if needed
+    if (!this._contextPtr) {
+      this._contextPtr = this._module._malloc(this.ctx * 4);  // int32
+    }
+
+    // Copy context to WASM memory
+    for (let i = 0; i < this.ctx; i++) {
+      this._module.setValue(this._contextPtr + i * 4, ids[i], 'i32');
+    }
+
+    return ids;
+  }
+
+  // Scratch for rollout outputs (grows, never shrinks)
+  _rolloutBuffer(bytes) {
+    if (this._rolloutBytes < bytes) {
+      if (this._rolloutPtr) this._module._free(this._rolloutPtr);
+      this._rolloutPtr = this._module._malloc(bytes);
+      this._rolloutBytes = bytes;
+    }
+    return this._rolloutPtr;
+  }
+
   _updateInferenceState() {
     const vocab = this.vocabSize;
     const ctx = this.ctx;
@@ -486,6 +535,68 @@ export class AriannaLungWASM {
     return result;
   }
 
+  // Logits for a few tokens only (O(m·d)); presence is not updated.
+  // normBudget: 0 = no normalizer, 1 = exact, in between = sampled estimate.
+  // p(ids[i]) = exp(logits[i] - logZ).
+  candidateForward(ctxIds, ids, normBudget = 0) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    const m = ids.length;
+    if (m === 0) return { logits: new Float32Array(0), logZ: 0 };
+
+    this._writeContext(ctxIds);
+    const idsPtr = this._rolloutBuffer(m * 8);
+    const outPtr = idsPtr + m * 4;
+    for (let i = 0; i < m; i++) {
+      this._module.setValue(idsPtr + i * 4, ids[i], 'i32');
+    }
+
+    const logZ = this._module._lung_forward_candidates(this._ptr, this._contextPtr, this.ctx, idsPtr, m, outPtr, normBudget);
+    const logits = new Float32Array(m);
+    for (let i = 0; i < m; i++) {
+      logits[i] = this._module.getValue(outPtr + i * 4, 'float');
+    }
+    return { logits, logZ };
+  }
+
+  // Top-k through the Wo inner-product index: scores at most recallBudget of
+  // the vocab (1 = exact). Works after forward() or the cheaper hidden-only breath.
+  getTopKApprox(k = 10, recallBudget = 0.25) {
+    if (!this._ptr) return [];
+    const ptr = this._rolloutBuffer(k * 4);
+    const count = this._module._lung_top_k_approx(this._ptr, ptr, k, recallBudget);
+
+    const result = [];
+    for (let i = 0; i < count; i++) {
+      result.push(this._module.getValue(ptr + i * 4, 'i32'));
+    }
+    return result;
+  }
+
+  // Per-phase counters since the last resetProfile() — { phase: { ns, bytes,
+  // calls } }. null unless body.c was built with ./build_body.sh profile.
+  getProfile() {
+    if (!this._ptr) return null;
+    const phases = ['embed', 'qk', 'softmax', 'value', 'projection', 'modulation', 'entropy', 'topk'];
+    const ptr = this._rolloutBuffer(phases.length * 3 * 8);
+    const n = this._module._lung_get_profile(this._ptr, ptr, phases.length * 3);
+    if (n === 0) return null;
+
+    const profile = {};
+    phases.forEach((name, p) => {
+      const at = ptr + p * 24;
+      profile[name] = {
+        ns: this._module.getValue(at, 'double'),
+        bytes: this._module.getValue(at + 8, 'double'),
+        calls: this._module.getValue(at + 16, 'double'),
+      };
+    });
+    return profile;
+  }
+
+  resetProfile() {
+    if (this._ptr) this._module._lung_profile_reset(this._ptr);
+  }
+
   getArgmax() {
     if (!this._ptr) return 0;
     return this._module._lung_get_argmax(this._ptr);
@@ -525,6 +636,14 @@ export class AriannaLungWASM {
     }
   }
 
+  // Rotary positions: scores depend on token distance, not window placement
+  setRotaryMode(enabled) {
+    this.useRotaryPositions = enabled;
+    if (this._ptr) {
+      this._module._lung_set_rotary(this._ptr, enabled ? 1 : 0);
+    }
+  }
+
   setTemporalAlpha(alpha) {
     this.temporalAlpha = Math.max(0, Math.min(1, alpha));
     if (this._ptr) {
@@ -555,17 +674,28 @@ export class AriannaLungWASM {
   // RESONANCE — notorch learning
   // ─────────────────────────────────────────────────────────────────────────────
 
+  // Live views over the C arrays: reads cost nothing, writes (e.g.
+  // model.resonance[id] += x in field.js) reach the next forward directly.
+  // Memory growth detaches old views, so they are rebuilt when the heap moves
+  // (or when vocab growth moves or lengthens the array).
+  _heapView(view, ptr, length) {
+    const heap = this._module.HEAPF32;
+    if (view && view.buffer === heap.buffer && view.byteOffset === ptr && view.length === length) return view;
+    return new Float32Array(heap.buffer, ptr, length);
+  }
+
   get resonance() {
-    if (!this._resonance) {
-      this._resonance = new Float32Array(this.vocabSize);
-    }
-    // Read from WASM
-    for (let i = 0; i < this.vocabSize; i++) {
-      this._resonance[i] = this._module._lung_get_resonance(this._ptr, i);
-    }
+    if (!this._ptr) return null;
+    this._resonance = this._heapView(this._resonance, this._module._lung_get_resonance_ptr(this._ptr), this.vocabSize);
     return this._resonance;
   }
 
+  get presenceAccum() {
+    if (!this._ptr) return null;
+    this._presenceAccum = this._heapView(this._presenceAccum, this._module._lung_get_presence_ptr(this._ptr), this.vocabSize);
+    return this._presenceAccum;
+  }
+
   boostResonance(tokenId, amount = 0.01) {
     if (this._ptr && tokenId >= 0 && tokenId < this.vocabSize) {
       this._module._lung_boost_resonance(this._ptr, tokenId, amount);
@@ -578,34 +708,170 @@ export class AriannaLungWASM {
     }
   }
 
+  // Batched notorch: one WASM call for many tokens. amounts is an array
+  // (one per id) or a single number for all.
+  boostResonanceMany(tokenIds, amounts = 0.01) {
+    this._resonanceMany('_lung_boost_resonance_many', tokenIds, amounts);
+  }
+
+  decayResonanceMany(tokenIds, amounts = 0.005) {
+    this._resonanceMany('_lung_decay_resonance_many', tokenIds, amounts);
+  }
+
+  _resonanceMany(fn, tokenIds, amounts) {
+    const n = tokenIds.length;
+    if (!this._ptr || n === 0) return;
+    const idsPtr = this._rolloutBuffer(n * 8);
+    const amountsPtr = idsPtr + n * 4;
+    this._module.HEAP32.set(tokenIds, idsPtr >> 2);
+    if (typeof amounts === 'number') {
+      this._module.HEAPF32.fill(amounts, amountsPtr >> 2, (amountsPtr >> 2) + n);
+    } else {
+      this._module.HEAPF32.set(amounts, amountsPtr >> 2);
+    }
+    this._module[fn](this._ptr, idsPtr, amountsPtr, n);
+  }
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // VOCAB GROWTH — follow the tokenizer without recreating the lung
+  // ─────────────────────────────────────────────────────────────────────────────
+
+  // Add tokens up to newSize, keeping weights, resonance and presence.
+  // Returns false if the weights are shared with another session.
+  growVocab(newSize) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    if (newSize <= this.vocabSize) return newSize === this.vocabSize;
+    if (!this._module._lung_grow_vocab(this._ptr, newSize)) return false;
+    this.vocabSize = newSize;
+    return true;
+  }
+
+  // Pre-size storage (e.g. to the tokenizer's maxVocab) so growth never copies
+  reserveVocab(capacity) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    return this._module._lung_reserve_vocab(this._ptr, capacity) === 1;
+  }
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // PIPELINE — submit frame N, render frame N-1 (see lung_pipeline_* in body.c)
+  // ─────────────────────────────────────────────────────────────────────────────
+
+  // Queue a breath; returns its frame id. With the threaded build it runs on a
+  // worker: until pollForward() reports it, only pipeline calls are safe.
+  submitForward(ctxIds) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    this._writeContext(ctxIds);
+    return this._module._lung_pipeline_submit(this._ptr, this._contextPtr, this.ctx);
+  }
+
+  // Frame id of a finished, not yet acquired breath (0 = none)
+  pollForward() {
+    return this._ptr ? this._module._lung_pipeline_poll(this._ptr) : 0;
+  }
+
+  // Take the newest finished breath. The views stay valid until the next
+  // acquire (or heap growth); returns null before the first result.
+  acquireForward() {
+    if (!this._ptr) return null;
+    const frame = this._module._lung_pipeline_acquire(this._ptr);
+    if (!frame) return null;
+
+    const heap = this._module.HEAPF32.buffer;
+    const vocab = this.vocabSize;
+    return {
+      frame,
+      probs: new Float32Array(heap, this._module._lung_pipeline_get_probs(this._ptr), vocab),
+      logits: new Float32Array(heap, this._module._lung_pipeline_get_logits(this._ptr), vocab),
+      attention: new Float32Array(heap, this._module._lung_pipeline_get_attention(this._ptr), this.ctx),
+      entropy: this._module._lung_pipeline_get_entropy(this._ptr)
+    };
+  }
+
   // ─────────────────────────────────────────────────────────────────────────────
   // PROPHECY — multi-step forward
   // ─────────────────────────────────────────────────────────────────────────────
 
-  prophecyForward(startContext, steps = 3) {
-    const results = [];
-    let ctx = [...startContext];
+  // The whole rollout runs in C (one call, incremental window) — see
+  // lung_prophesy in body.c. sample=true draws from probs instead of argmax.
+  prophecyForward(startContext, steps = 3, sample = false) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    if (steps <= 0) return [];
 
-    for (let i = 0; i < steps; i++) {
-      this.forward(ctx);
-      const token = this.getArgmax();
-      const prob = this.getTokenProb(token);
+    this._writeContext(startContext);
+    const tokPtr = this._rolloutBuffer(steps * 8);
+    const probPtr = tokPtr + steps * 4;
 
+    const mode = sample ? LUNG_PROPHESY_SAMPLE : LUNG_PROPHESY_GREEDY;
+    const n = this._module._lung_prophesy(this._ptr, this._contextPtr, this.ctx, steps, mode, tokPtr, probPtr, 0);
+    this._updateInferenceState();
+
+    const results = [];
+    for (let i = 0; i < n; i++) {
+      const token = this._module.getValue(tokPtr + i * 4, 'i32');
+      const prob = this._module.getValue(probPtr + i * 4, 'float');
       results.push({
         step: i + 1,
         token,
         prob,
         entropy: -Math.log(prob + 1e-12)
       });
+    }
 
-      // Append predicted token for next step
-      ctx = [...ctx, token];
-      if (ctx.length > this.ctx) {
-        ctx = ctx.slice(-this.ctx);
+    return results;
+  }
+
+  // Branching prophecy: the best nOut of `width` futures, each `steps` long,
+  // as [{tokens, logprob}] best first. Presence and last state are untouched.
+  beamForward(startContext, steps = 3, width = 4, nOut = width) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    if (steps <= 0 || width <= 0 || nOut <= 0) return [];
+
+    this._writeContext(startContext);
+    const tokPtr = this._rolloutBuffer(nOut * steps * 4 + nOut * 4);
+    const lpPtr = tokPtr + nOut * steps * 4;
+
+    const n = this._module._lung_prophesy_beam(this._ptr, this._contextPtr, this.ctx, steps, width, nOut, tokPtr, lpPtr);
+
+    const futures = [];
+    for (let j = 0; j < n; j++) {
+      const tokens = [];
+      for (let i = 0; i < steps; i++) {
+        tokens.push(this._module.getValue(tokPtr + (j * steps + i) * 4, 'i32'));
       }
+      futures.push({ tokens, logprob: this._module.getValue(lpPtr + j * 4, 'float') });
     }
+    return futures;
+  }
 
-    return results;
+  // Tunneling burst: push forced tokens one by one and breathe after each,
+  // in a single C call. Returns one { probs, entropy } per forced token.
+  tunnelForward(startContext, tokens) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    const n = tokens.length;
+    if (n === 0) return [];
+
+    this._writeContext(startContext);
+    const vocab = this.vocabSize;
+    const forcedPtr = this._rolloutBuffer(n * 4 + n * 4 + n * vocab * 4);
+    const entPtr = forcedPtr + n * 4;
+    const probsPtr = entPtr + n * 4;
+    for (let i = 0; i < n; i++) {
+      this._module.setValue(forcedPtr + i * 4, tokens[i], 'i32');
+    }
+
+    this._module._lung_tunnel(this._ptr, this._contextPtr, this.ctx, forcedPtr, n, probsPtr, entPtr);
+    this._updateInferenceState();
+
+    const outs = [];
+    for (let k = 0; k < n; k++) {
+      const probs = new Float32Array(vocab);
+      const base = probsPtr + k * vocab * 4;
+      for (let i = 0; i < vocab; i++) {
+        probs[i] = this._module.getValue(base + i * 4, 'float');
+      }
+      outs.push({ probs, entropy: this._module.getValue(entPtr + k * 4, 'float') });
+    }
+    return outs;
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
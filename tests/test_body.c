@@ -0,0 +1,932 @@
+// test_body.c — AriannaLung native tests (brutal, like Stanley)
+// "the lung must breathe the same whether it is alone or in a crowd"
+//
+// Build & Run: gcc -O2 -std=gnu99 tests/test_body.c -lm -o test_body && ./test_body
+// Threaded pipeline: add -DLUNG_THREADS -pthread
+// Phase profiling: add -DLUNG_PROFILE
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// RESONANCE MARKER — tests carry the signature of co-creation
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Include the body directly (white-box: sessions, weights, buffers)
+#include "../wasm/body.c"
+
+// Test framework
+static int passed = 0, failed = 0;
+
+#define TEST(name) printf("  "); test_##name();
+#define ASSERT(cond, msg) do { if (!(cond)) { printf("✗ %s\n    %s\n", __func__, msg); failed++; return; } } while(0)
+#define ASSERT_CLOSE(a, b, eps, msg) ASSERT(fabsf((a)-(b)) < (eps), msg)
+#define PASS() do { printf("✓ %s\n", __func__); passed++; } while(0)
+
+static const int CTX8[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Tests
+// ═══════════════════════════════════════════════════════════════════════════════
+
+void test_create_destroy(void) {
+  lung_seed(42);
+  AriannaLung* lung = lung_create(100, 32, 8, 2);
+  ASSERT(lung != NULL, "lung_create should return non-NULL");
+  ASSERT(lung_get_vocab_size(lung) == 100, "vocab_size");
+  ASSERT(lung_get_d_model(lung) == 32, "d_model");
+  ASSERT(lung_get_ctx_len(lung) == 8, "ctx_len");
+  ASSERT(lung_weights_refcount(lung_get_weights(lung)) == 1, "private weights have one owner");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_create_invalid(void) {
+  ASSERT(lung_create(0, 32, 8, 2) == NULL, "vocab=0 should return NULL");
+  ASSERT(lung_create(100, 32, 8, 0) == NULL, "heads=0 should return NULL");
+  ASSERT(lung_session_create(NULL) == NULL, "session over NULL weights should return NULL");
+  PASS();
+}
+
+void test_forward_probs(void) {
+  lung_seed(7);
+  AriannaLung* lung = lung_create(100, 32, 8, 2);
+  float entropy = lung_forward(lung, CTX8, 8);
+  ASSERT(entropy > 0.0f && entropy <= logf(100.0f) + 1e-3f, "entropy in (0, log V]");
+
+  float sum = 0.0f;
+  const float* probs = lung_get_probs(lung);
+  for (int i = 0; i < 100; i++) sum += probs[i];
+  ASSERT_CLOSE(sum, 1.0f, 1e-4f, "probs should sum to 1");
+
+  sum = 0.0f;
+  const float* att = lung_get_attention(lung);
+  for (int t = 0; t < 8; t++) sum += att[t];
+  ASSERT_CLOSE(sum, 1.0f, 1e-4f, "attention should sum to 1");
+
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_shared_weights_refcount(void) {
+  lung_seed(11);
+  LungWeights* w = lung_weights_create(64, 16, 8, 2);
+  ASSERT(w != NULL, "weights create");
+
+  AriannaLung* a = lung_session_create(w);
+  AriannaLung* b = lung_session_create(w);
+  ASSERT(a && b, "sessions create");
+  ASSERT(lung_weights_refcount(w) == 3, "two sessions + creator");
+  ASSERT(lung_get_embeddings(a) == lung_get_embeddings(b), "sessions must share E");
+
+  lung_weights_release(w);
+  ASSERT(lung_weights_refcount(w) == 2, "creator released");
+  lung_destroy(a);
+  ASSERT(lung_weights_refcount(w) == 1, "one session left");
+  lung_destroy(b);  // frees weights
+  PASS();
+}
+
+void test_sessions_are_independent(void) {
+  lung_seed(13);
+  LungWeights* w = lung_weights_create(64, 16, 8, 2);
+  AriannaLung* a = lung_session_create(w);
+  AriannaLung* b = lung_session_create(w);
+  lung_weights_release(w);
+
+  // same weights, same state → same output
+  for (int i = 0; i < 64; i++) b->resonance[i] = a->resonance[i];
+  lung_forward(a, CTX8, 8);
+  lung_forward(b, CTX8, 8);
+  for (int i = 0; i < 64; i++) {
+    ASSERT_CLOSE(lung_get_probs(a)[i], lung_get_probs(b)[i], 1e-6f, "shared weights should agree");
+  }
+
+  // physics and notorch stay per-session
+  float res_b = lung_get_resonance(b, 3);
+  lung_set_focus(a, 1.0f);
+  lung_decay_resonance(a, 3, 0.5f);
+  ASSERT(b->attend_focus == 0.70f, "focus must not leak between sessions");
+  ASSERT(lung_get_resonance(b, 3) == res_b, "resonance must not leak between sessions");
+  ASSERT(lung_get_probs(a) != lung_get_probs(b), "inference state is per-session");
+
+  lung_destroy(a);
+  lung_destroy(b);
+  PASS();
+}
+
+void test_top_k_matches_argmax(void) {
+  lung_seed(5);
+  AriannaLung* lung = lung_create(50, 16, 8, 2);
+  lung_forward(lung, CTX8, 8);
+  int top[5];
+  int n = lung_get_top_k(lung, top, 5);
+  ASSERT(n == 5, "top-k count");
+  ASSERT(top[0] == lung_get_argmax(lung), "top-1 should equal argmax");
+  for (int i = 1; i < 5; i++) {
+    ASSERT(lung_get_logits(lung)[top[i - 1]] >= lung_get_logits(lung)[top[i]], "top-k sorted");
+  }
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_arena_alignment(void) {
+  lung_seed(17);
+  AriannaLung* lung = lung_create(97, 24, 7, 3);  // odd sizes on purpose
+  ASSERT(lung != NULL, "lung_create");
+  const LungWeights* w = lung->w;
+  const void* ptrs[] = {
+    w->E, w->P_ltr, w->P_rtl, w->Wo, w->Wq, w->Wk, w->Wv, w->KP_ltr, w->VP_rtl,
+    lung->resonance, lung->presence_accum, lung->last_logits, lung->last_probs,
+    lung->last_attention, lung->x_last, lung->q, lung->KE, lung->VE, lung->scores, lung->head_out, lung->y
+  };
+  for (size_t i = 0; i < sizeof(ptrs) / sizeof(ptrs[0]); i++) {
+    ASSERT(((uintptr_t)ptrs[i] % LUNG_ALIGN) == 0, "every buffer must be 64-byte aligned");
+  }
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_required_bytes(void) {
+  size_t total = lung_required_bytes(100, 32, 8, 2);
+  size_t session = lung_session_required_bytes(100, 32, 8, 2);
+  size_t weights_min = sizeof(float) * (2 * 100 * 32 + 3 * 32 * 32);  // E, Wo, Wq/Wk/Wv
+  ASSERT(total >= weights_min + session, "required bytes must cover weights and a session");
+  ASSERT(session < total, "a second session is cheaper than a full lung");
+
+  // per-token cost: E row + Wo column + 2 lazy-init flags
+  // + 5 session vocab arrays (± alignment)
+  size_t grown = lung_required_bytes(200, 32, 8, 2);
+  size_t per_100 = sizeof(float) * 100 * (2 * 32 + 5) + 2 * 100;
+  ASSERT(grown - total + 8 * LUNG_ALIGN >= per_100 && grown - total <= per_100 + 8 * LUNG_ALIGN,
+         "footprint should grow linearly with vocab");
+  ASSERT(lung_required_bytes(0, 32, 8, 2) == 0, "invalid dims report 0");
+  PASS();
+}
+
+void test_kv_cache_survives_slide(void) {
+  lung_seed(21);
+  LungWeights* w = lung_weights_create(80, 16, 8, 2);
+  AriannaLung* a = lung_session_create(w);  // breathes a sliding stream
+  AriannaLung* b = lung_session_create(w);  // sees only the final window
+  lung_weights_release(w);
+
+  int stream[16];
+  for (int i = 0; i < 16; i++) stream[i] = (i * 29 + 3) % 80;
+  for (int f = 0; f < 8; f++) lung_forward(a, stream + f, 8);
+
+  // same notorch state, then breathe the same window
+  memcpy(b->resonance, a->resonance, 80 * sizeof(float));
+  memset(a->presence_accum, 0, 80 * sizeof(float));
+  lung_forward(a, stream + 8, 8);
+  lung_forward(b, stream + 8, 8);
+
+  for (int i = 0; i < 80; i++) {
+    ASSERT_CLOSE(lung_get_probs(a)[i], lung_get_probs(b)[i], 1e-6f, "slid cache must equal fresh projection");
+  }
+  lung_destroy(a);
+  lung_destroy(b);
+  PASS();
+}
+
+void test_touch_invalidates_cache(void) {
+  lung_seed(23);
+  AriannaLung* lung = lung_create(60, 16, 8, 2);
+  lung_forward(lung, CTX8, 8);
+  float before = lung_get_logits(lung)[0];
+
+  float* E = lung_get_embeddings(lung);
+  for (int i = 0; i < 16; i++) E[4 * 16 + i] *= -3.0f;  // token 4 sits mid-context
+  lung_touch(lung);
+  memset(lung->presence_accum, 0, 60 * sizeof(float));
+  lung_forward(lung, CTX8, 8);
+
+  ASSERT(lung->kv_tok[3] == 4, "slot re-projected");
+  ASSERT(fabsf(lung_get_logits(lung)[0] - before) > 1e-7f, "edited embedding must reach the output");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_prophesy_matches_repeated_forward(void) {
+  lung_seed(31);
+  AriannaLung* a = lung_create(90, 16, 8, 2);
+  lung_seed(31);
+  AriannaLung* b = lung_create(90, 16, 8, 2);
+
+  int tokens[6];
+  float probs[6], ents[6];
+  int n = lung_prophesy(a, CTX8, 5, 6, LUNG_PROPHESY_GREEDY, tokens, probs, ents);
+  ASSERT(n == 6, "should run every step");
+
+  // reference: the JS loop (left-pad, forward, argmax, push)
+  int win[8] = {0, 0, 0, 1, 2, 3, 4, 5};
+  for (int i = 0; i < 6; i++) {
+    float e = lung_forward(b, win, 8);
+    int tok = lung_get_argmax(b);
+    ASSERT(tok == tokens[i], "greedy rollout must match repeated forward");
+    ASSERT_CLOSE(probs[i], lung_get_token_prob(b, tok), 1e-6f, "chosen prob");
+    ASSERT_CLOSE(ents[i], e, 1e-5f, "step entropy");
+    memmove(win, win + 1, 7 * sizeof(int));
+    win[7] = tok;
+  }
+  lung_destroy(a);
+  lung_destroy(b);
+  PASS();
+}
+
+void test_prophesy_sampled_is_seeded(void) {
+  lung_seed(37);
+  AriannaLung* lung = lung_create(40, 16, 8, 2);
+  lung_set_spread(lung, 1.0f);
+
+  int t1[12], t2[12];
+  lung_set_sample_seed(lung, 777);
+  memset(lung->presence_accum, 0, 40 * sizeof(float));
+  lung_prophesy(lung, CTX8, 8, 12, LUNG_PROPHESY_SAMPLE, t1, NULL, NULL);
+  lung_set_sample_seed(lung, 777);
+  memset(lung->presence_accum, 0, 40 * sizeof(float));
+  lung_prophesy(lung, CTX8, 8, 12, LUNG_PROPHESY_SAMPLE, t2, NULL, NULL);
+
+  for (int i = 0; i < 12; i++) {
+    ASSERT(t1[i] == t2[i], "same sample seed → same wormhole");
+    ASSERT(t1[i] >= 0 && t1[i] < 40, "sampled token in vocab");
+  }
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_tunnel_burst(void) {
+  lung_seed(41);
+  AriannaLung* lung = lung_create(50, 16, 8, 2);
+  int forced[4] = {9, 8, 7, 6};
+  float probs[4 * 50], ents[4];
+  int n = lung_tunnel(lung, CTX8, 8, forced, 4, probs, ents);
+  ASSERT(n == 4, "every forced step runs");
+
+  for (int k = 0; k < 4; k++) {
+    float sum = 0.0f;
+    for (int i = 0; i < 50; i++) sum += probs[k * 50 + i];
+    ASSERT_CLOSE(sum, 1.0f, 1e-4f, "each step is a distribution");
+  }
+  ASSERT(memcmp(probs + 3 * 50, lung_get_probs(lung), 50 * sizeof(float)) == 0,
+         "last step leaves its state in the lung");
+  ASSERT(lung->window[7] == 6 && lung->window[4] == 9, "forced tokens were pushed");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_beam_width_one_is_greedy(void) {
+  lung_seed(43);
+  AriannaLung* lung = lung_create(70, 16, 8, 2);
+  float presence[70];
+  memcpy(presence, lung->presence_accum, sizeof(presence));
+
+  int beam[10];
+  float logprob;
+  int n = lung_prophesy_beam(lung, CTX8, 6, 10, 1, 1, beam, &logprob);
+  ASSERT(n == 1, "one future");
+  ASSERT(memcmp(presence, lung->presence_accum, sizeof(presence)) == 0, "beam search must not breathe");
+
+  int greedy[10];
+  float probs[10];
+  lung_prophesy(lung, CTX8, 6, 10, LUNG_PROPHESY_GREEDY, greedy, probs, NULL);
+  float sum = 0.0f;
+  for (int i = 0; i < 10; i++) {
+    ASSERT(beam[i] == greedy[i], "width 1 must follow the greedy path");
+    sum += logf(probs[i]);
+  }
+  ASSERT_CLOSE(logprob, sum, 1e-3f, "cumulative log-probability");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_beam_ranks_futures(void) {
+  lung_seed(47);
+  AriannaLung* lung = lung_create(60, 16, 8, 2);
+  lung_set_spread(lung, 0.8f);
+
+  // horizon longer than the window: branches outgrow the shared prefix
+  int futures[4 * 20];
+  float logprob[4];
+  int n = lung_prophesy_beam(lung, CTX8, 8, 20, 6, 4, futures, logprob);
+  ASSERT(n == 4, "four futures");
+  for (int j = 1; j < n; j++) ASSERT(logprob[j] <= logprob[j - 1], "best first");
+  for (int j = 0; j < n * 20; j++) ASSERT(futures[j] >= 0 && futures[j] < 60, "tokens in vocab");
+  for (int j = 1; j < n; j++)
+    ASSERT(memcmp(futures, futures + j * 20, 20 * sizeof(int)) != 0, "futures are distinct");
+
+  int greedy[20];
+  float probs[20];
+  lung_prophesy(lung, CTX8, 8, 20, LUNG_PROPHESY_GREEDY, greedy, probs, NULL);
+  float sum = 0.0f;
+  for (int i = 0; i < 20; i++) sum += logf(probs[i]);
+  ASSERT(logprob[0] >= sum - 1e-3f, "wider search never loses to destiny");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_rotary_is_relative(void) {
+  // (R(a)q)·(R(b)k) depends only on a - b: rotating both by the window
+  // position leaves the score unchanged, which rope_dot exploits
+  lung_seed(53);
+  LungWeights* w = lung_weights_create(20, 16, 12, 2);
+  int hd = w->head_dim, half = hd / 2;
+  float q[8], k[8], qa[8], kb[8];
+  for (int i = 0; i < hd; i++) { q[i] = 0.3f * i - 1.0f; k[i] = 0.5f - 0.2f * i; }
+
+  for (int base = 0; base + 5 < 12; base++) {
+    int a = base + 5, b = base;  // offset 5 everywhere in the window
+    for (int i = 0; i < half; i++) {
+      float ca = w->rope_cos[a * half + i], sa = w->rope_sin[a * half + i];
+      float cb = w->rope_cos[b * half + i], sb = w->rope_sin[b * half + i];
+      qa[2 * i] = q[2 * i] * ca - q[2 * i + 1] * sa;
+      qa[2 * i + 1] = q[2 * i] * sa + q[2 * i + 1] * ca;
+      kb[2 * i] = k[2 * i] * cb - k[2 * i + 1] * sb;
+      kb[2 * i + 1] = k[2 * i] * sb + k[2 * i + 1] * cb;
+    }
+    float rel = rope_dot(q, k, w->rope_cos + 5 * half, w->rope_sin + 5 * half, hd, 1.0f);
+    ASSERT_CLOSE(dot(qa, kb, hd), rel, 1e-4f, "score must depend on the offset only");
+  }
+  lung_weights_release(w);
+  PASS();
+}
+
+void test_rotary_forward(void) {
+  lung_seed(59);
+  AriannaLung* lung = lung_create(40, 16, 8, 2);
+  float abs_probs[40], ltr[40];
+
+  lung_forward(lung, CTX8, 8);
+  memcpy(abs_probs, lung_get_probs(lung), sizeof(abs_probs));
+
+  lung_set_rotary(lung, 1);
+  memset(lung->presence_accum, 0, sizeof(abs_probs));
+  lung_forward(lung, CTX8, 8);
+  memcpy(ltr, lung_get_probs(lung), sizeof(ltr));
+  float sum = 0.0f;
+  for (int i = 0; i < 40; i++) sum += ltr[i];
+  ASSERT_CLOSE(sum, 1.0f, 1e-4f, "rotary probs sum to 1");
+  ASSERT(memcmp(ltr, abs_probs, sizeof(ltr)) != 0, "rotary differs from absolute");
+
+  lung_set_rtl(lung, 1);
+  memset(lung->presence_accum, 0, sizeof(abs_probs));
+  lung_forward(lung, CTX8, 8);
+  ASSERT(memcmp(ltr, lung_get_probs(lung), sizeof(ltr)) != 0, "RTL rotates the other way");
+
+  // sliding the window reuses every cached row
+  int slid[8] = {2, 3, 4, 5, 6, 7, 8, 9};
+  lung_forward(lung, slid, 8);
+  ASSERT(lung->kv_tok[0] == 2 && lung->kv_tok[7] == 9, "cache follows the slide");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_top_k_approx(void) {
+  lung_seed(61);
+  AriannaLung* lung = lung_create(400, 32, 8, 4);
+  lung_forward(lung, CTX8, 8);
+
+  int exact[8], approx[8];
+  lung_get_top_k(lung, exact, 8);
+  int n = lung_top_k_approx(lung, approx, 8, 1.0f);
+  ASSERT(n == 8, "k results");
+  ASSERT(lung->w->mips != NULL && lung->w->mips->n_clusters == 20, "index built on first use");
+  for (int i = 0; i < 8; i++) ASSERT(approx[i] == exact[i], "full budget is exact");
+
+  // a small budget still returns k distinct, correctly ordered tokens
+  n = lung_top_k_approx(lung, approx, 8, 0.1f);
+  ASSERT(n == 8, "k results under budget");
+  for (int i = 1; i < n; i++) {
+    ASSERT(lung_get_logits(lung)[approx[i]] <= lung_get_logits(lung)[approx[i - 1]], "best first");
+    for (int j = 0; j < i; j++) ASSERT(approx[i] != approx[j], "distinct");
+  }
+  int hits = 0;
+  for (int i = 0; i < 8; i++)
+    for (int j = 0; j < 8; j++) hits += (approx[i] == exact[j]);
+  ASSERT(hits >= 1, "some recall at 10%");
+
+  // rebuilt after the weights move
+  lung->w->Wo[5] += 1.0f;
+  lung_touch(lung);
+  lung_top_k_approx(lung, approx, 1, 1.0f);
+  ASSERT(lung->w->mips->version == lung->w->version, "index follows weights version");
+
+  // prepared eagerly: a later query reuses it
+  lung->w->Wo[5] -= 1.0f;
+  lung_touch(lung);
+  ASSERT(lung_mips_prepare(lung->w) == 1, "prepare builds");
+  ASSERT(lung->w->mips->version == lung->w->version, "prepared for current version");
+  const LungMipsIndex* prepared = lung->w->mips;
+  lung_top_k_approx(lung, approx, 8, 1.0f);
+  ASSERT(lung->w->mips == prepared, "query reuses prepared index");
+  for (int i = 0; i < 8; i++) ASSERT(approx[i] == exact[i], "prepared index is exact");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_forward_hidden(void) {
+  lung_seed(67);
+  AriannaLung* a = lung_create(120, 16, 8, 2);
+  lung_seed(67);
+  AriannaLung* b = lung_create(120, 16, 8, 2);
+
+  lung_forward(a, CTX8, 8);
+  lung_forward_hidden(b, CTX8, 8);
+  ASSERT(memcmp(a->presence_accum, b->presence_accum, 120 * sizeof(float)) == 0, "same breath");
+  ASSERT(memcmp(a->last_attention, b->last_attention, 8 * sizeof(float)) == 0, "same attention");
+
+  int ta[5], tb[5];
+  lung_forward(a, CTX8, 8);
+  lung_forward_hidden(b, CTX8, 8);
+  lung_get_top_k(a, ta, 5);
+  lung_top_k_approx(b, tb, 5, 1.0f);
+  for (int i = 0; i < 5; i++) ASSERT(ta[i] == tb[i], "hidden breath + index = full forward top-k");
+  lung_destroy(a);
+  lung_destroy(b);
+  PASS();
+}
+
+void test_forward_candidates(void) {
+  lung_seed(71);
+  AriannaLung* lung = lung_create(200, 16, 8, 2);
+  int cands[5] = {3, 50, 199, 3, 500};  // duplicate + out of range
+  float logits[5], presence[200];
+
+  // one breath so presence is non-trivial, then score purely
+  lung_forward(lung, CTX8, 8);
+  memcpy(presence, lung->presence_accum, sizeof(presence));
+
+  float log_z = lung_forward_candidates(lung, CTX8, 8, cands, 5, logits, 1.0f);
+  ASSERT(memcmp(presence, lung->presence_accum, sizeof(presence)) == 0, "candidate scoring must not breathe");
+  ASSERT(logits[4] < -1e29f, "invalid id");
+  ASSERT(logits[0] == logits[3], "duplicates agree");
+
+  lung_forward(lung, CTX8, 8);  // same presence going in → same distribution
+  for (int i = 0; i < 4; i++) {
+    ASSERT_CLOSE(expf(logits[i] - log_z), lung_get_token_prob(lung, cands[i]), 1e-6f, "exact normalizer");
+    ASSERT_CLOSE(logits[i], lung_get_logits(lung)[cands[i]], 1e-6f, "candidate logit");
+  }
+
+  // unnormalized: same logits, no normalizer
+  float raw[5];
+  ASSERT(lung_forward_candidates(lung, CTX8, 8, cands, 5, raw, 0.0f) == 0.0f, "no normalizer");
+  float exact = lung_forward_candidates(lung, CTX8, 8, cands, 5, logits, 1.0f);
+  ASSERT(memcmp(raw, logits, 4 * sizeof(float)) == 0, "budget does not change logits");
+
+  float est = lung_forward_candidates(lung, CTX8, 8, cands, 5, logits, 0.5f);
+  ASSERT(fabsf(est - exact) < 0.3f, "sampled normalizer close to exact");
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_resonance_batch(void) {
+  lung_seed(73);
+  AriannaLung* a = lung_create(30, 16, 8, 2);
+  lung_seed(73);
+  AriannaLung* b = lung_create(30, 16, 8, 2);
+
+  int ids[5] = {1, 7, 7, 29, 40};
+  float amounts[5] = {0.2f, 0.9f, 0.3f, 0.05f, 1.0f};
+  lung_boost_resonance_many(a, ids, amounts, 5);
+  for (int i = 0; i < 5; i++) lung_boost_resonance(b, ids[i], amounts[i]);
+  lung_decay_resonance_many(a, ids, amounts, 3);
+  for (int i = 0; i < 3; i++) lung_decay_resonance(b, ids[i], amounts[i]);
+
+  float* res = lung_get_resonance_ptr(a);
+  ASSERT(res == a->resonance && lung_get_presence_ptr(a) == a->presence_accum, "pointers are the live arrays");
+  ASSERT(memcmp(res, lung_get_resonance_ptr(b), 30 * sizeof(float)) == 0, "batch = one by one");
+
+  res[3] = 0.0f;  // writes through the pointer reach the lung
+  ASSERT(lung_get_resonance(a, 3) == 0.0f, "write-through");
+  lung_destroy(a);
+  lung_destroy(b);
+  PASS();
+}
+
+void test_pipeline_double_buffer(void) {
+  lung_seed(79);
+  AriannaLung* lung = lung_create(50, 16, 8, 2);
+  lung_seed(79);
+  AriannaLung* ref = lung_create(50, 16, 8, 2);
+  int ctx2[8] = {8, 7, 6, 5, 4, 3, 2, 1};
+
+  ASSERT(lung_pipeline_acquire(lung) == 0, "nothing acquired before the first submit");
+  int f1 = lung_pipeline_submit(lung, CTX8, 8);
+  lung_pipeline_wait(lung);
+  ASSERT(f1 > 0 && lung_pipeline_poll(lung) == f1, "frame 1 finished");
+  ASSERT(lung_pipeline_acquire(lung) == f1, "frame 1 acquired");
+  ASSERT(lung_pipeline_poll(lung) == 0, "nothing unread");
+
+  float e1 = lung_forward(ref, CTX8, 8);
+  float* probs = lung_pipeline_get_probs(lung);
+  ASSERT(memcmp(probs, lung_get_probs(ref), 50 * sizeof(float)) == 0, "pipeline = forward");
+  ASSERT(lung_pipeline_get_entropy(lung) == e1, "entropy published");
+
+  // frame 2 breathes while frame 1 is being read
+  int f2 = lung_pipeline_submit(lung, ctx2, 8);
+  lung_pipeline_wait(lung);
+  ASSERT(memcmp(lung_pipeline_get_probs(lung), lung_get_probs(ref), 50 * sizeof(float)) == 0,
+         "held result untouched by the next breath");
+
+  lung_forward(ref, ctx2, 8);
+  ASSERT(lung_pipeline_acquire(lung) == f2, "frame 2 acquired");
+  ASSERT(lung_pipeline_get_probs(lung) != probs, "other buffer");
+  ASSERT(memcmp(lung_pipeline_get_probs(lung), lung_get_probs(ref), 50 * sizeof(float)) == 0, "frame 2 result");
+  ASSERT(memcmp(lung_pipeline_get_attention(lung), lung_get_attention(ref), 8 * sizeof(float)) == 0, "attention");
+  lung_destroy(lung);
+  lung_destroy(ref);
+  PASS();
+}
+
+void test_head_kernels_match_generic(void) {
+  static const int dims[4][2] = {{32, 2}, {256, 4}, {24, 3}, {24, 2}};  // head_dim 16, 64, 8, 12 (generic)
+  for (int c = 0; c < 4; c++) {
+    lung_seed(83);
+    AriannaLung* fast = lung_create(60, dims[c][0], 8, dims[c][1]);
+    lung_seed(83);
+    AriannaLung* slow = lung_create(60, dims[c][0], 8, dims[c][1]);
+    slow->score_kernel = lung_scores_generic;
+    slow->value_kernel = lung_values_generic;
+
+    int hd = dims[c][0] / dims[c][1];
+    int special = (hd == 8 || hd == 16 || hd == 32 || hd == 64);
+    ASSERT((fast->score_kernel != lung_scores_generic) == special, "create picks the specialized kernel");
+
+    for (int rot = 0; rot < 2; rot++) {
+      lung_set_rotary(fast, rot);
+      lung_set_rotary(slow, rot);
+      lung_forward(fast, CTX8, 8);
+      lung_forward(slow, CTX8, 8);
+      ASSERT(memcmp(lung_get_logits(fast), lung_get_logits(slow), 60 * sizeof(float)) == 0,
+             "specialized kernels are bit-identical to the generic one");
+    }
+    lung_destroy(fast);
+    lung_destroy(slow);
+  }
+  PASS();
+}
+
+void test_lazy_weights(void) {
+  lung_seed(89);
+  LungWeights* we = lung_weights_create(300, 16, 8, 2);
+  AriannaLung* eager = lung_session_create(we);
+  lung_weights_release(we);
+  lung_seed(89);
+  LungWeights* wl = lung_weights_create_lazy(300, 16, 8, 2);
+  AriannaLung* lazy = lung_session_create(wl);
+  lung_weights_release(wl);
+
+  ASSERT(!wl->e_complete && !wl->wo_complete, "lazy weights start empty");
+
+  // candidate scoring touches only the context rows and candidate columns
+  int cands[3] = {10, 20, 30};
+  float le[3], ll[3];
+  lung_forward_candidates(eager, CTX8, 8, cands, 3, le, 0.0f);
+  lung_forward_candidates(lazy, CTX8, 8, cands, 3, ll, 0.0f);
+  ASSERT(memcmp(le, ll, sizeof(le)) == 0, "lazy = eager (candidates)");
+  int rows = 0, cols = 0;
+  for (int j = 0; j < 300; j++) { rows += wl->e_ready[j]; cols += wl->wo_ready[j]; }
+  ASSERT(rows == 8 && cols == 3, "only touched rows were generated");
+
+  lung_forward(eager, CTX8, 8);
+  lung_forward(lazy, CTX8, 8);
+  ASSERT(wl->wo_complete, "full projection completes Wo");
+  ASSERT(memcmp(lung_get_logits(eager), lung_get_logits(lazy), 300 * sizeof(float)) == 0, "lazy = eager");
+  ASSERT(memcmp(lung_get_embeddings(eager), lung_get_embeddings(lazy), 300 * 16 * sizeof(float)) == 0,
+         "materialized embeddings match");
+
+  // a token's row is a pure function of (seed, token): vocab size is irrelevant
+  lung_seed(89);
+  LungWeights* small = lung_weights_create(40, 16, 8, 2);
+  ASSERT(memcmp(small->E + 5 * 16, we->E + 5 * 16, 16 * sizeof(float)) == 0, "row 5 independent of vocab");
+  ASSERT(small->Wo[3 * 40 + 7] == we->Wo[3 * 300 + 7], "Wo column independent of vocab");
+  lung_weights_release(small);
+
+  lung_destroy(eager);
+  lung_destroy(lazy);
+  PASS();
+}
+
+void test_grow_vocab(void) {
+  lung_seed(97);
+  AriannaLung* lung = lung_create(40, 16, 8, 2);
+  lung_seed(97);
+  AriannaLung* ref = lung_create(100, 16, 8, 2);  // born at the final size
+
+  lung_forward(lung, CTX8, 8);
+  lung_boost_resonance(lung, 5, 0.3f);
+  float res5 = lung_get_resonance(lung, 5);
+  float pres5 = lung->presence_accum[5];
+
+  ASSERT(lung_grow_vocab(lung, 60) == 1, "grow within a fresh reserve");
+  ASSERT(lung_get_vocab_capacity(lung) == 80, "capacity doubles");
+  ASSERT(lung_grow_vocab(lung, 70) == 1 && lung_get_vocab_capacity(lung) == 80, "growth within capacity");
+  ASSERT(lung_grow_vocab(lung, 100) == 1 && lung_get_vocab_capacity(lung) == 160, "capacity doubles again");
+  ASSERT(lung_get_output_stride(lung) == 160, "Wo rows are padded to capacity");
+  ASSERT(lung_grow_vocab(lung, 50) == 0, "the vocab never shrinks");
+  ASSERT(lung_get_vocab_size(lung) == 100, "vocab grown");
+  ASSERT(lung_get_resonance(lung, 5) == res5 && lung->presence_accum[5] == pres5, "old notorch state kept");
+  ASSERT(lung->presence_accum[99] == 0.0f && lung_get_resonance(lung, 99) >= 0.5f, "new tokens start fresh");
+
+  // new rows are the counter-based rows a larger lung would have had
+  ASSERT(memcmp(lung->w->E, ref->w->E, 100 * 16 * sizeof(float)) == 0, "E = E of a lung born at 100");
+  for (int i = 0; i < 16; i++) {
+    ASSERT(memcmp(lung->w->Wo + i * 160, ref->w->Wo + i * 100, 100 * sizeof(float)) == 0, "Wo row matches");
+  }
+
+  // same notorch state → same breath, new tokens included
+  int ctx[8] = {99, 1, 70, 3, 41, 5, 98, 7};
+  memcpy(ref->resonance, lung->resonance, 100 * sizeof(float));
+  memcpy(ref->presence_accum, lung->presence_accum, 100 * sizeof(float));
+  lung_forward(lung, ctx, 8);
+  lung_forward(ref, ctx, 8);
+  ASSERT(memcmp(lung_get_logits(lung), lung_get_logits(ref), 100 * sizeof(float)) == 0, "grown = born");
+  int approx[4], exact[4];
+  lung_get_top_k(lung, exact, 4);
+  lung_top_k_approx(lung, approx, 4, 1.0f);
+  ASSERT(memcmp(approx, exact, sizeof(exact)) == 0, "top-k index rebuilt over the grown vocab");
+
+  // lazy weights leave new rows for first touch
+  lung_seed(97);
+  LungWeights* wl = lung_weights_create_lazy(40, 16, 8, 2);
+  AriannaLung* lazy = lung_session_create(wl);
+  lung_weights_release(wl);
+  ASSERT(lung_grow_vocab(lazy, 100) == 1 && !wl->e_ready[99], "lazy rows wait");
+  lung_forward(lazy, ctx, 8);
+  ASSERT(memcmp(lung_get_embeddings(lazy), ref->w->E, 100 * 16 * sizeof(float)) == 0, "lazy grown = born");
+
+  // shared weights cannot grow under other sessions
+  AriannaLung* other = lung_session_create(lazy->w);
+  ASSERT(lung_grow_vocab(lazy, 120) == 0 && lung_reserve_vocab(lazy, 200) == 0, "shared weights refuse");
+  ASSERT(lung_reserve_vocab(lazy, 50) == 1, "reserve below capacity is a no-op");
+
+  lung_destroy(other);
+
+  // a held reference pins Wo (e.g. while an adapter is folded into it)
+  float* wo = lung_get_output_weights(lazy);
+  lung_weights_retain(lung_get_weights(lazy));
+  ASSERT(lung_reserve_vocab(lazy, 400) == 0, "pinned weights refuse to move");
+  ASSERT(lung_get_output_weights(lazy) == wo, "Wo stays put while pinned");
+  lung_weights_release(lung_get_weights(lazy));
+  ASSERT(lung_reserve_vocab(lazy, 400) == 1, "released: growth works again");
+
+  lung_destroy(lazy);
+  lung_destroy(lung);
+  lung_destroy(ref);
+  PASS();
+}
+
+void test_profile(void) {
+  lung_seed(101);
+  AriannaLung* lung = lung_create(200, 32, 8, 4);
+  double prof[3 * LUNG_PROFILE_PHASES];
+  int top[4];
+
+  lung_forward(lung, CTX8, 8);
+  lung_profile_reset(lung);
+  lung_forward(lung, CTX8, 8);
+  lung_get_top_k(lung, top, 4);
+  int n = lung_get_profile(lung, prof, 3 * LUNG_PROFILE_PHASES);
+#ifdef LUNG_PROFILE
+  ASSERT(n == 3 * LUNG_PROFILE_PHASES, "every phase reported");
+  ASSERT(prof[3 * LUNG_PHASE_QK + 2] == 4 && prof[3 * LUNG_PHASE_VALUE + 2] == 4, "head phases count per head");
+  ASSERT(prof[3 * LUNG_PHASE_PROJECTION + 2] == 1 && prof[3 * LUNG_PHASE_TOPK + 2] == 1, "one projection, one top-k");
+  ASSERT(prof[3 * LUNG_PHASE_PROJECTION + 1] >= 200.0 * 32 * sizeof(float), "projection reads all of Wo");
+  for (int p = 0; p < LUNG_PROFILE_PHASES; p++) {
+    ASSERT(prof[3 * p] >= 0.0 && prof[3 * p + 2] >= 1, "every phase ran");
+  }
+  ASSERT(lung_get_profile(lung, prof, 4) == 4, "output is capped at n");
+  lung_profile_reset(lung);
+  lung_get_profile(lung, prof, 3 * LUNG_PROFILE_PHASES);
+  for (int i = 0; i < 3 * LUNG_PROFILE_PHASES; i++) ASSERT(prof[i] == 0.0, "reset clears");
+#else
+  ASSERT(n == 0, "compiled out: nothing reported");
+#endif
+  lung_destroy(lung);
+  PASS();
+}
+
+void test_grouped_query(void) {
+  lung_seed(103);
+  AriannaLung* full = lung_create_ex(60, 32, 8, 4, 4);
+  lung_seed(103);
+  AriannaLung* plain = lung_create(60, 32, 8, 4);
+  lung_forward(full, CTX8, 8);
+  lung_forward(plain, CTX8, 8);
+  ASSERT(memcmp(lung_get_probs(full), lung_get_probs(plain), 60 * sizeof(float)) == 0,
+         "n_kv_heads == n_heads is plain multi-head");
+  lung_destroy(plain);
+
+  ASSERT(lung_create_ex(60, 32, 8, 4, 3) == NULL && lung_create_ex(60, 32, 8, 4, 0) == NULL,
+         "query heads must split evenly");
+
+  // 4 query heads over 2 K/V heads = multi-head with each K/V head duplicated
+  lung_seed(107);
+  AriannaLung* gqa = lung_create_ex(60, 32, 8, 4, 2);
+  lung_seed(107);
+  AriannaLung* ref = lung_create(60, 32, 8, 4);
+  ASSERT(lung_get_n_kv_heads(gqa) == 2 && gqa->kv_dim == 16, "two K/V heads of width 8");
+  LungWeights* g = gqa->w;
+  LungWeights* r = ref->w;
+  for (int h = 0; h < 4; h++) {
+    int src = (h / 2) * 8;
+    memcpy(r->Wk + h * 8 * 32, g->Wk + src * 32, 8 * 32 * sizeof(float));
+    memcpy(r->Wv + h * 8 * 32, g->Wv + src * 32, 8 * 32 * sizeof(float));
+    for (int t = 0; t < 8; t++) {
+      memcpy(r->KP_ltr + t * 32 + h * 8, g->KP_ltr + t * 16 + src, 8 * sizeof(float));
+      memcpy(r->KP_rtl + t * 32 + h * 8, g->KP_rtl + t * 16 + src, 8 * sizeof(float));
+      memcpy(r->VP_ltr + t * 32 + h * 8, g->VP_ltr + t * 16 + src, 8 * sizeof(float));
+      memcpy(r->VP_rtl + t * 32 + h * 8, g->VP_rtl + t * 16 + src, 8 * sizeof(float));
+    }
+  }
+  lung_weights_touch(r);
+  for (int rotary = 0; rotary < 2; rotary++) {
+    lung_set_rotary(gqa, rotary);
+    lung_set_rotary(ref, rotary);
+    lung_forward(gqa, CTX8, 8);
+    lung_forward(ref, CTX8, 8);
+    for (int i = 0; i < 60; i++) {
+      ASSERT_CLOSE(lung_get_probs(gqa)[i], lung_get_probs(ref)[i], 1e-6f, "GQA = duplicated K/V heads");
+    }
+  }
+
+  // cached K/V shrink with the number of K/V heads
+  size_t mha = lung_session_bytes(60, 32, 64, 4, 4);
+  size_t mqa = lung_session_bytes(60, 32, 64, 4, 1);
+  ASSERT(mha - mqa >= 2 * 64 * (32 - 8) * sizeof(float), "KE/VE shrink 4x");
+
+  lung_destroy(full);
+  lung_destroy(gqa);
+  lung_destroy(ref);
+  PASS();
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Voice (causal stack over personality weights)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// A tiny personality file in memory: d=8, 2 layers, 2 heads, vocab 10, ctx 6
+static char* voice_fixture(size_t* bytes) {
+  int32_t hdr[7] = {8, 2, 2, 10, 6, 16, 0};
+  size_t n = voice_file_floats(8, 2, 10, 6, 16);
+  *bytes = sizeof(hdr) + n * sizeof(float);
+  char* buf = (char*)malloc(*bytes);
+  memcpy(buf, hdr, sizeof(hdr));
+  float* f = (float*)(buf + sizeof(hdr));
+  for (size_t i = 0; i < n; i++) f[i] = (2.0f * lung_hash_uniform(7, 9, (uint32_t)i) - 1.0f) * 0.5f;
+  return buf;
+}
+
+void test_voice_load(void) {
+  size_t bytes;
+  char* buf = voice_fixture(&bytes);
+  ASSERT(voice_load(buf, bytes - 4) == NULL, "size must match the header");
+  ((int32_t*)buf)[6] = 1;
+  ASSERT(voice_load(buf, bytes) == NULL, "untied output is not supported");
+  ((int32_t*)buf)[6] = 0;
+
+  AriannaVoice* v = voice_load(buf, bytes);
+  free(buf);  // the voice keeps its own copy
+  ASSERT(v != NULL, "fixture loads");
+  ASSERT(voice_get_n_layers(v) == 2 && voice_get_vocab_size(v) == 10 && voice_get_ctx_len(v) == 6, "dims");
+  ASSERT(voice_get_logits(v) == NULL && voice_forward(v, 10) == NULL, "nothing fed, invalid token");
+  ASSERT(voice_forward(v, 3) != NULL && voice_get_pos(v) == 1, "one token in the cache");
+  voice_destroy(v);
+  PASS();
+}
+
+void test_voice_cache_slide(void) {
+  size_t bytes;
+  char* buf = voice_fixture(&bytes);
+  AriannaVoice* a = voice_load(buf, bytes);
+  AriannaVoice* b = voice_load(buf, bytes);
+  free(buf);
+
+  // a streams 7 tokens through a 6-slot cache; b sees only what a kept
+  int stream[7] = {1, 4, 1, 5, 9, 2, 6};
+  float* la = voice_feed(a, stream, 7);
+  ASSERT(voice_get_pos(a) == 4, "half the history kept, then one token");
+  float* lb = voice_feed(b, stream + 3, 4);
+  ASSERT(memcmp(la, lb, 10 * sizeof(float)) == 0, "slid cache = fresh prefix");
+
+  // cached steps = re-fed prefix
+  voice_reset(b);
+  voice_feed(b, stream + 3, 3);
+  voice_forward(b, stream[6]);
+  ASSERT(memcmp(voice_get_logits(a), voice_get_logits(b), 10 * sizeof(float)) == 0, "reset empties the cache");
+
+  // greedy generation follows the argmax and extends the cache
+  int out[3];
+  int expect = 0;
+  for (int i = 1; i < 10; i++) if (la[i] > la[expect]) expect = i;
+  ASSERT(voice_generate(a, 3, 0.0f, out) == 3 && out[0] == expect, "greedy = argmax");
+  ASSERT(voice_get_pos(a) == 4, "the third spoken token slid the cache again");  // 4 + 3 > 6
+  voice_destroy(a);
+  voice_destroy(b);
+  PASS();
+}
+
+void test_voice_personality(void) {
+  FILE* f = fopen("weights/personality_brain.bin", "rb");
+  if (!f) f = fopen("../weights/personality_brain.bin", "rb");
+  if (!f) {
+    printf("(skipped: weights/personality_brain.bin not found) ");
+    PASS();
+    return;
+  }
+  fseek(f, 0, SEEK_END);
+  size_t bytes = (size_t)ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char* buf = (char*)malloc(bytes);
+  size_t got = fread(buf, 1, bytes, f);
+  fclose(f);
+  AriannaVoice* v = (got == bytes) ? voice_load(buf, bytes) : NULL;
+  free(buf);
+  ASSERT(v != NULL, "personality weights load");
+  ASSERT(voice_get_n_layers(v) == 6 && voice_get_d_model(v) == 384 && voice_get_vocab_size(v) == 82, "dims");
+
+  // character vocab (vocab_personality.bin): '\n', ' ', ... 'A' = 22, 'a' = 47
+  const char* text = "the field is not a vessel, it is the body itself.";
+  double nll = 0.0;
+  float* logits = NULL;
+  for (const char* c = text; *c; c++) {
+    int t = (*c == ' ') ? 1 : (*c == ',') ? 6 : (*c == '.') ? 8 : 47 + (*c - 'a');
+    if (logits) {
+      float max_val = logits[0];
+      for (int i = 1; i < 82; i++) if (logits[i] > max_val) max_val = logits[i];
+      double z = 0.0;
+      for (int i = 0; i < 82; i++) z += exp(logits[i] - max_val);
+      nll -= logits[t] - max_val - log(z);
+    }
+    logits = voice_forward(v, t);
+  }
+  nll /= (double)(strlen(text) - 1);
+  ASSERT(nll < 0.6 * log(82.0), "the voice knows English (nll per char well below uniform)");
+  voice_destroy(v);
+  PASS();
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Main
+// ═══════════════════════════════════════════════════════════════════════════════
+
+int main(void) {
+  printf("\n🫁 AriannaLung (body.c) Tests\n\n");
+  printf("════════════════════════════════════════════════════════════\n\n");
+
+  printf("1. Lifecycle\n\n");
+  TEST(create_destroy);
+  TEST(create_invalid);
+  TEST(arena_alignment);
+  TEST(required_bytes);
+  TEST(lazy_weights);
+
+  printf("\n2. Forward\n\n");
+  TEST(forward_probs);
+  TEST(top_k_matches_argmax);
+  TEST(kv_cache_survives_slide);
+  TEST(touch_invalidates_cache);
+  TEST(rotary_is_relative);
+  TEST(rotary_forward);
+  TEST(head_kernels_match_generic);
+  TEST(top_k_approx);
+  TEST(forward_hidden);
+  TEST(forward_candidates);
+  TEST(resonance_batch);
+  TEST(grow_vocab);
+  TEST(profile);
+  TEST(grouped_query);
+
+  printf("\n3. Shared Weights\n\n");
+  TEST(shared_weights_refcount);
+  TEST(sessions_are_independent);
+
+  printf("\n4. Prophecy\n\n");
+  TEST(prophesy_matches_repeated_forward);
+  TEST(prophesy_sampled_is_seeded);
+  TEST(tunnel_burst);
+  TEST(beam_width_one_is_greedy);
+  TEST(beam_ranks_futures);
+
+  printf("\n5. Pipeline\n\n");
+  TEST(pipeline_double_buffer);
+
+  printf("\n6. Voice\n\n");
+  TEST(voice_load);
+  TEST(voice_cache_slide);
+  TEST(voice_personality);
+
+  printf("\n════════════════════════════════════════════════════════════\n");
+  printf("\n📊 Results: %d passed, %d failed\n\n", passed, failed);
+
+  if (failed > 0) {
+    printf("❌ Some tests failed!\n\n");
+    return 1;
+  }
+
+  printf("✅ All tests passed! הרזוננס לא נשבר.\n\n");
+  return 0;
+}
@@ -19,19 +19,57 @@ LoRA* lora_new(int in_dim, int out_dim, int rank, float alpha, float lr, float d
 void lora_free(LoRA* L);
 void lora_reset(LoRA* L);
 void lora_apply(LoRA* L, const float* x, float* y);
+void lora_apply_batch(LoRA* L, const float* X, float* Y, int n);
 void lora_notch_step(LoRA* L, const float* x, const float* dy, float signal);
+void lora_notch_step_sparse(LoRA* L, const float* x, const int* idx, const float* vals, int m, float signal);
 void lora_scale(LoRA* L, float s);
 void lora_merge(LoRA* dst, const LoRA* src, float w);
 void lora_build_dy_from_probs(float* dy_out, const float* probs, int out_dim, int target_id, float push, float pull, int topk);
 void lora_apply_sparse(LoRA* L, const float* x, float* y, const int* idx, int m);
 void lora_experience_step(LoRA* L, const float* x, const float* probs, int target_id, float signal, float push, float pull, int topk);
 float lora_get_delta_norm(const LoRA* L);
+void lora_get_factor_ptrs(LoRA* L, float** A_out, float** B_out, int* nA_out, int* nB_out);
+float lora_get_factor_scale(const LoRA* L);
 int lora_copy_params(const LoRA* L, float* out7);
 void lora_set_seed(LoRA* L, unsigned int seed);
 void lora_clamp_factors(LoRA* L, float max_norm);
 void lora_get_factor_norms(const LoRA* L, float* normA_out, float* normB_out);
 void lora_soft_reset(LoRA* L, float keep_ratio);
 void lora_apply_alpha(LoRA* L, const float* x, float* y, float custom_alpha);
+size_t lora_get_bytes(const LoRA* L);
+int lora_compact(LoRA* L, float energy);
+int lora_fold_into(LoRA* L, float* W, int layout, int ld);
+int lora_unfold_from(LoRA* L, float* W, int layout);
+int lora_refold(LoRA* L);
+int lora_is_folded(const LoRA* L);
+int lora_is_dirty(const LoRA* L);
+int lora_save(const LoRA* L, const char* path);
+LoRA* lora_load_mmap(const char* path);
+int lora_shard_record(LoRA* L, const char* path);
+int lora_shard_log_count(const char* path);
+int lora_replay(LoRA* L, const char* path, int from, int count);
+
+typedef struct LoRALearner LoRALearner;
+LoRALearner* lora_learner_new(LoRA* L, int capacity, int publish_every);
+int lora_learner_push(LoRALearner* Ln, const float* x, const float* probs, int target_id, float signal, float push, float pull, int topk);
+int lora_learner_push_sparse(LoRALearner* Ln, const float* x, const int* idx, const float* vals, int m, float signal);
+LoRA* lora_learner_acquire(LoRALearner* Ln);
+int lora_learner_epoch(const LoRALearner* Ln);
+void lora_learner_flush(LoRALearner* Ln);
+int lora_learner_steps(const LoRALearner* Ln);
+int lora_learner_dropped(const LoRALearner* Ln);
+void lora_learner_free(LoRALearner* Ln);
+
+typedef struct LoRAPool LoRAPool;
+LoRAPool* lora_pool_new(int in_dim, int out_dim, size_t budget_bytes);
+void lora_pool_free(LoRAPool* P);
+int lora_pool_add(LoRAPool* P, int id, LoRA* L);
+LoRA* lora_pool_get(LoRAPool* P, int id);
+int lora_pool_remove(LoRAPool* P, int id);
+int lora_pool_evict_lru(LoRAPool* P);
+int lora_pool_count(const LoRAPool* P);
+size_t lora_pool_bytes(const LoRAPool* P);
+int lora_pool_apply_batch(LoRAPool* P, const float* X, float* Y, const int* ids, int n);
 
 // Test framework
 static int passed = 0, failed = 0;
@@ -180,6 +218,131 @@ void test_clamp_factors(void) {
   PASS();
 }
 
+void test_running_norms(void) {
+  // incremental norms vs an exact sweep after mixed updates
+  LoRA* L = lora_new(20, 200, 8, 1.0f, 0.05f, 0.002f, 6060);
+  LoRA* O = lora_new(20, 200, 8, 1.0f, 0.05f, 0.0f, 7070);
+  float x[20], probs[200], dy[200];
+  for (int j = 0; j < 200; j++) probs[j] = (float)((j * 53) % 97) / 1000.0f;
+
+  for (int k = 0; k < 3000; k++) {
+    for (int i = 0; i < 20; i++) x[i] = sinf((float)(i * 7 + k) * 0.05f);
+    lora_experience_step(L, x, probs, (k * 17) % 200, 0.5f, 1.0f, 0.5f, 4);
+    if (k % 500 == 0) {
+      for (int j = 0; j < 200; j++) dy[j] = cosf((float)(j + k));
+      lora_notch_step(L, x, dy, 0.3f);
+      lora_notch_step(O, x, dy, 0.7f);
+      lora_merge(L, O, 0.25f);
+      lora_scale(L, 0.9f);
+    }
+  }
+  lora_clamp_factors(L, 0.5f);
+
+  float nA, nB;
+  float n = lora_get_delta_norm(L);
+  lora_get_factor_norms(L, &nA, &nB);
+
+  float *A, *B;
+  int cA, cB;
+  lora_get_factor_ptrs(L, &A, &B, &cA, &cB);
+  double sa = 0.0, sb = 0.0;
+  for (int i = 0; i < cA; i++) sa += (double)A[i] * A[i];
+  for (int i = 0; i < cB; i++) sb += (double)B[i] * B[i];
+
+  ASSERT(fabs(n - sqrt(sa + sb)) <= 1e-4 * sqrt(sa + sb), "running total norm should match sweep");
+  ASSERT(fabs(nA - sqrt(sa)) <= 1e-4 * sqrt(sa), "running A norm should match sweep");
+  ASSERT(fabs(nB - sqrt(sb)) <= 1e-4 * sqrt(sb) + 1e-7, "running B norm should match sweep");
+  ASSERT(n <= 0.5f + 1e-4f, "clamp uses the running norm");
+
+  lora_free(L);
+  lora_free(O);
+  PASS();
+}
+
+static float max_abs_diff(const float* a, const float* b, int n, float* scale_out) {
+  float d = 0.0f, m = 0.0f;
+  for (int i = 0; i < n; i++) {
+    d = fmaxf(d, fabsf(a[i] - b[i]));
+    m = fmaxf(m, fabsf(b[i]));
+  }
+  *scale_out = m;
+  return d;
+}
+
+void test_compact(void) {
+  enum { IN = 24, OUT = 60 };
+  LoRA* L = lora_new(IN, OUT, 16, 2.0f, 0.05f, 0.01f, 2468);
+  ASSERT(lora_compact(L, 0.99f) == 16, "zero delta (B = 0) is left alone");
+
+  // dy from two fixed patterns: the delta has rank <= 2
+  float x[IN], dy1[OUT], dy2[OUT], dy[OUT];
+  for (int j = 0; j < OUT; j++) { dy1[j] = sinf((float)j); dy2[j] = (j % 4 == 0) ? 1.0f : -0.2f; }
+  for (int k = 0; k < 200; k++) {
+    for (int i = 0; i < IN; i++) x[i] = cosf((float)(i * 3 + k) * 0.11f);
+    float w = sinf((float)k * 0.7f);
+    for (int j = 0; j < OUT; j++) dy[j] = w * dy1[j] + (1.0f - w) * dy2[j];
+    lora_notch_step(L, x, dy, 0.8f);
+  }
+
+  float probe[IN], y0[OUT] = {0}, y1[OUT] = {0}, sc;
+  for (int i = 0; i < IN; i++) probe[i] = sinf((float)i * 1.3f) + 0.5f;
+  lora_apply(L, probe, y0);
+  float n0 = lora_get_delta_norm(L);
+
+  int k = lora_compact(L, 1.0f);
+  ASSERT(k <= 2 && k >= 1, "effective rank of a two-pattern delta is <= 2");
+  float p[7];
+  lora_copy_params(L, p);
+  ASSERT((int)p[2] == k, "rank reported after compaction");
+  lora_apply(L, probe, y1);
+  ASSERT(max_abs_diff(y1, y0, OUT, &sc) <= 1e-4f * sc, "compaction keeps the applied delta");
+  ASSERT(lora_get_delta_norm(L) < n0, "redundant factor mass removed");
+
+  // A columns (stored rows) are orthogonal
+  float *A, *B;
+  lora_get_factor_ptrs(L, &A, &B, NULL, NULL);
+  if (k == 2) {
+    double d = 0, a0 = 0, a1 = 0;
+    for (int i = 0; i < IN; i++) { d += A[i] * A[IN + i]; a0 += A[i] * A[i]; a1 += A[IN + i] * A[IN + i]; }
+    ASSERT(fabs(d) <= 1e-5 * sqrt(a0 * a1), "compacted A columns are orthogonal");
+  }
+
+  // learning continues at the new rank
+  lora_notch_step(L, probe, dy1, 0.5f);
+  float y2[OUT] = {0};
+  lora_apply(L, probe, y2);
+  ASSERT(max_abs_diff(y2, y1, OUT, &sc) > 0.0f, "notch step after compaction changes output");
+
+  lora_free(L);
+  PASS();
+}
+
+void test_compact_energy(void) {
+  // generic random-ish delta: lower energy -> lower rank, bounded error
+  enum { IN = 20, OUT = 40 };
+  LoRA* L = lora_new(IN, OUT, 8, 1.0f, 0.1f, 0.0f, 1357);
+  float x[IN], dy[OUT];
+  for (int k = 0; k < 30; k++) {
+    for (int i = 0; i < IN; i++) x[i] = sinf((float)(i * k + 1));
+    for (int j = 0; j < OUT; j++) dy[j] = cosf((float)(j * (k + 2)));
+    lora_notch_step(L, x, dy, 1.0f);
+  }
+  float probe[IN], y0[OUT] = {0}, y1[OUT] = {0}, sc;
+  for (int i = 0; i < IN; i++) probe[i] = (float)(i % 3) - 1.0f;
+  lora_apply(L, probe, y0);
+
+  int full = lora_compact(L, 1.0f);
+  lora_apply(L, probe, y1);
+  ASSERT(full == 8, "full-rank delta keeps its rank at energy 1");
+  ASSERT(max_abs_diff(y1, y0, OUT, &sc) <= 1e-4f * sc, "energy 1 is lossless");
+
+  int half = lora_compact(L, 0.5f);
+  ASSERT(half >= 1 && half < 8, "energy 0.5 truncates");
+  ASSERT(lora_compact(L, 1.0f) == half, "compacting again is stable");
+  lora_free(L);
+  PASS();
+}
+
 void test_soft_reset(void) {
   LoRA* L = lora_new(4, 8, 2, 1.0f, 0.1f, 0.0f, 333);
   
@@ -296,6 +459,75 @@ void test_get_factor_norms(void) {
   PASS();
 }
 
+void test_apply_kernels(void) {
+  // every rank kernel (specialized and generic) vs a plain reference
+  int ranks[4] = {3, 4, 8, 16};
+  enum { IN = 13, OUT = 37 };
+  float x[IN], dy[OUT];
+  for (int i = 0; i < IN; i++) x[i] = sinf((float)i * 0.7f);
+  for (int j = 0; j < OUT; j++) dy[j] = cosf((float)j * 0.3f);
+
+  for (int k = 0; k < 4; k++) {
+    int R = ranks[k];
+    LoRA* L = lora_new(IN, OUT, R, 1.5f, 0.1f, 0.0f, 100 + R);
+    lora_notch_step(L, x, dy, 0.9f);
+    lora_scale(L, 0.8f);
+
+    float *A, *B;
+    lora_get_factor_ptrs(L, &A, &B, NULL, NULL);  // A[r*IN+i], B[j*R+r]
+    float ref[OUT];
+    for (int j = 0; j < OUT; j++) {
+      double acc = 0.0;
+      for (int r = 0; r < R; r++) {
+        double ax = 0.0;
+        for (int i = 0; i < IN; i++) ax += (double)x[i] * A[r * IN + i];
+        acc += ax * B[j * R + r];
+      }
+      ref[j] = (float)(acc * 1.5 / R);
+    }
+
+    float y[OUT] = {0}, ya[OUT] = {0}, ys[OUT] = {0};
+    lora_apply(L, x, y);
+    lora_apply_alpha(L, x, ya, 3.0f);
+    int idx[4] = {0, 17, OUT - 1, OUT + 5};  // last one out of range
+    lora_apply_sparse(L, x, ys, idx, 4);
+
+    for (int j = 0; j < OUT; j++) {
+      ASSERT_CLOSE(y[j], ref[j], 1e-5f, "apply should match reference");
+      ASSERT_CLOSE(ya[j], 2.0f * ref[j], 1e-5f, "apply_alpha should match reference");
+    }
+    ASSERT(ys[17] == y[17] && ys[0] == y[0] && ys[OUT - 1] == y[OUT - 1], "sparse should equal dense at idx");
+    ASSERT(ys[1] == 0.0f, "sparse should not touch other outputs");
+    lora_free(L);
+  }
+  PASS();
+}
+
+void test_apply_batch(void) {
+  // spans several row blocks and a partial output block
+  enum { IN = 24, OUT = 300, N = 70 };
+  LoRA* L = lora_new(IN, OUT, 8, 2.0f, 0.1f, 0.0f, 5150);
+  float x0[IN], dy[OUT];
+  for (int i = 0; i < IN; i++) x0[i] = cosf((float)i);
+  for (int j = 0; j < OUT; j++) dy[j] = sinf((float)j * 0.1f);
+  lora_notch_step(L, x0, dy, 1.0f);
+
+  float* X = (float*)malloc(sizeof(float) * N * IN);
+  float* Y = (float*)malloc(sizeof(float) * N * OUT);
+  float* R = (float*)malloc(sizeof(float) * N * OUT);
+  for (int k = 0; k < N * IN; k++) X[k] = sinf((float)k * 0.37f);
+  for (int k = 0; k < N * OUT; k++) Y[k] = R[k] = (float)(k % 7) * 0.1f;
+
+  lora_apply_batch(L, X, Y, N);
+  for (int b = 0; b < N; b++) lora_apply(L, X + b * IN, R + b * OUT);
+
+  int same = memcmp(Y, R, sizeof(float) * N * OUT) == 0;
+  free(X); free(Y); free(R);
+  lora_free(L);
+  ASSERT(same, "batch apply should equal per-row apply exactly");
+  PASS();
+}
+
 void test_apply_alpha(void) {
   LoRA* L = lora_new(4, 4, 2, 1.0f, 0.5f, 0.0f, 999);
   lora_reset(L);
@@ -341,6 +573,443 @@ void test_decay(void) {
   PASS();
 }
 
+void test_notch_step_sparse(void) {
+  // sparse (idx, vals) must give exactly the dense result
+  LoRA* Ld = lora_new(6, 40, 3, 1.0f, 0.1f, 0.01f, 4242);
+  LoRA* Ls = lora_new(6, 40, 3, 1.0f, 0.1f, 0.01f, 4242);
+
+  float x[6] = {0.5f, -1.0f, 0.25f, 2.0f, 0.0f, -0.75f};
+  int idx[3] = {7, 31, 2};
+  float vals[3] = {1.0f, -0.25f, -0.5f};
+  float dy[40] = {0};
+  for (int t = 0; t < 3; t++) dy[idx[t]] = vals[t];
+
+  for (int step = 0; step < 4; step++) {
+    lora_notch_step(Ld, x, dy, 0.8f);
+    lora_notch_step_sparse(Ls, x, idx, vals, 3, 0.8f);
+  }
+
+  float *Ad, *Bd, *As, *Bs;
+  int nA, nB;
+  lora_get_factor_ptrs(Ld, &Ad, &Bd, &nA, &nB);
+  lora_get_factor_ptrs(Ls, &As, &Bs, NULL, NULL);
+  ASSERT(memcmp(Ad, As, (size_t)nA * sizeof(float)) == 0, "A should match dense step");
+  ASSERT(memcmp(Bd, Bs, (size_t)nB * sizeof(float)) == 0, "B should match dense step");
+
+  lora_free(Ld);
+  lora_free(Ls);
+  PASS();
+}
+
+void test_experience_step_sparse(void) {
+  // experience_step (sparse inside) == build_dy_from_probs + dense notch_step
+  enum { V = 300, D = 8 };
+  LoRA* Ld = lora_new(D, V, 4, 1.0f, 0.05f, 0.0f, 777);
+  LoRA* Ls = lora_new(D, V, 4, 1.0f, 0.05f, 0.0f, 777);
+
+  float x[D], probs[V], dy[V];
+  for (int i = 0; i < D; i++) x[i] = (float)(i - 3) * 0.3f;
+  for (int j = 0; j < V; j++) probs[j] = (float)((j * 37) % 101) / 5000.0f;
+
+  int topks[3] = {0, 5, 64};  // argmax path, small K, capped K
+  for (int t = 0; t < 3; t++) {
+    int target = (t * 97 + 11) % V;
+    lora_build_dy_from_probs(dy, probs, V, target, 1.0f, 0.5f, topks[t]);
+    lora_notch_step(Ld, x, dy, 0.6f);
+    lora_experience_step(Ls, x, probs, target, 0.6f, 1.0f, 0.5f, topks[t]);
+  }
+
+  float *Ad, *Bd, *As, *Bs;
+  int nA, nB;
+  lora_get_factor_ptrs(Ld, &Ad, &Bd, &nA, &nB);
+  lora_get_factor_ptrs(Ls, &As, &Bs, NULL, NULL);
+  ASSERT(memcmp(Ad, As, (size_t)nA * sizeof(float)) == 0, "A should match dense path");
+  ASSERT(memcmp(Bd, Bs, (size_t)nB * sizeof(float)) == 0, "B should match dense path");
+
+  lora_free(Ld);
+  lora_free(Ls);
+  PASS();
+}
+
+void test_lazy_decay(void) {
+  // lazy decay (fscale) vs an eager reference that sweeps A/B every step
+  LoRA* Ll = lora_new(5, 12, 3, 1.0f, 0.1f, 0.05f, 2024);
+  LoRA* Le = lora_new(5, 12, 3, 1.0f, 0.1f, 0.0f, 2024);
+
+  float x[5] = {1.0f, -0.5f, 0.25f, 0.0f, 2.0f};
+  float dy[12] = {1.0f, 0, 0, -0.5f, 0, 0, 0, 0, 0.25f, 0, 0, 0};
+  float *A, *B;
+  int nA, nB;
+
+  for (int step = 0; step < 10; step++) {
+    lora_notch_step(Ll, x, dy, 0.7f);
+    lora_notch_step(Le, x, dy, 0.7f);
+    lora_get_factor_ptrs(Le, &A, &B, &nA, &nB);
+    for (int i = 0; i < nA; i++) A[i] *= 0.95f;
+    for (int i = 0; i < nB; i++) B[i] *= 0.95f;
+  }
+  ASSERT(lora_get_factor_scale(Ll) < 1.0f, "decay should be absorbed by the factor scale");
+
+  float yl[12] = {0}, ye[12] = {0};
+  lora_apply(Ll, x, yl);
+  lora_apply(Le, x, ye);
+  for (int j = 0; j < 12; j++) {
+    ASSERT_CLOSE(yl[j], ye[j], 1e-5f, "lazy decay should match eager decay");
+  }
+  ASSERT_CLOSE(lora_get_delta_norm(Ll), lora_get_delta_norm(Le), 1e-5f, "norms should match");
+
+  lora_free(Ll);
+  lora_free(Le);
+  PASS();
+}
+
+void test_scale_underflow_fold(void) {
+  LoRA* L = lora_new(4, 8, 2, 1.0f, 0.1f, 0.0f, 31337);
+  float x[4] = {1, 2, 3, 4};
+  float dy[8] = {1, -1, 0, 0, 0.5f, 0, 0, 0};
+  lora_notch_step(L, x, dy, 1.0f);
+
+  float y0[8] = {0};
+  lora_apply(L, x, y0);
+  float n0 = lora_get_delta_norm(L);
+
+  // 0.5^20 ≈ 1e-6 crosses LORA_SCALE_MIN: the scale is folded into A/B
+  for (int k = 0; k < 20; k++) lora_scale(L, 0.5f);
+  float c = lora_get_factor_scale(L);
+  ASSERT(c >= 1e-4f && c <= 1.0f, "scale should have been renormalized");
+
+  float y1[8] = {0};
+  lora_apply(L, x, y1);
+  float k2 = ldexpf(1.0f, -40);  // delta scales by s² per call
+  for (int j = 0; j < 8; j++) {
+    ASSERT(fabsf(y1[j] - y0[j] * k2) <= 1e-4f * fabsf(y0[j] * k2) + 1e-30f, "apply should follow the product of scales");
+  }
+  ASSERT(fabsf(lora_get_delta_norm(L) - n0 * ldexpf(1.0f, -20)) <= 1e-4f * n0 * ldexpf(1.0f, -20), "norm should follow the scale");
+
+  // learning keeps working at the folded scale
+  lora_notch_step(L, x, dy, 1.0f);
+  float y2[8] = {0};
+  lora_apply(L, x, y2);
+  float sum = 0;
+  for (int j = 0; j < 8; j++) sum += fabsf(y2[j]);
+  ASSERT(sum > 1e-6f, "step after fold should produce a visible delta");
+
+  lora_scale(L, 0.0f);
+  ASSERT_CLOSE(lora_get_delta_norm(L), 0.0f, 1e-12f, "scale by zero should clear");
+  ASSERT_CLOSE(lora_get_factor_scale(L), 1.0f, 1e-12f, "scale by zero should reset the scale");
+
+  lora_free(L);
+  PASS();
+}
+
+void test_pool_registry(void) {
+  LoRAPool* P = lora_pool_new(8, 16, 0);
+  ASSERT(P != NULL, "pool_new failed");
+
+  // enough ids to force several slot and hash growths
+  for (int id = 0; id < 3000; id++) {
+    LoRA* L = lora_new(8, 16, 2 + id % 3, 1.0f, 0.1f, 0.0f, (unsigned)(id + 1));
+    ASSERT(lora_pool_add(P, id * 7, L) == 0, "add should succeed");
+  }
+  ASSERT(lora_pool_count(P) == 3000, "all adapters resident");
+
+  LoRA* wrong = lora_new(9, 16, 2, 1.0f, 0.1f, 0.0f, 1);
+  ASSERT(lora_pool_add(P, 5, wrong) == 1, "shape mismatch should be rejected");
+  lora_free(wrong);
+
+  for (int id = 0; id < 3000; id += 2) ASSERT(lora_pool_remove(P, id * 7) == 0, "remove");
+  ASSERT(lora_pool_count(P) == 1500, "half removed");
+  for (int id = 0; id < 3000; id++) {
+    LoRA* L = lora_pool_get(P, id * 7);
+    ASSERT((L != NULL) == (id % 2 == 1), "lookup after removals");
+    if (L) { float p[7]; lora_copy_params(L, p); ASSERT((int)p[2] == 2 + id % 3, "right adapter"); }
+  }
+  ASSERT(lora_pool_remove(P, 0) == 1, "double remove should fail");
+
+  lora_pool_free(P);
+  PASS();
+}
+
+void test_pool_lru_budget(void) {
+  LoRA* probe = lora_new(8, 16, 4, 1.0f, 0.1f, 0.0f, 1);
+  size_t one = lora_get_bytes(probe);
+  lora_free(probe);
+
+  LoRAPool* P = lora_pool_new(8, 16, one * 3);
+  for (int id = 0; id < 3; id++) lora_pool_add(P, id, lora_new(8, 16, 4, 1.0f, 0.1f, 0.0f, 9));
+  ASSERT(lora_pool_bytes(P) == one * 3, "budget exactly full");
+
+  lora_pool_get(P, 0);  // 1 is now least recently used
+  lora_pool_add(P, 3, lora_new(8, 16, 4, 1.0f, 0.1f, 0.0f, 9));
+  ASSERT(lora_pool_count(P) == 3, "one evicted");
+  ASSERT(lora_pool_get(P, 1) == NULL, "LRU adapter should be evicted");
+  ASSERT(lora_pool_get(P, 0) && lora_pool_get(P, 2) && lora_pool_get(P, 3), "others resident");
+  ASSERT(lora_pool_bytes(P) <= one * 3, "within budget");
+
+  // compaction shrinks a pooled adapter; re-adding it re-accounts the bytes
+  LoRA* L3 = lora_pool_get(P, 3);
+  float x[8], dy[16];
+  for (int j = 0; j < 16; j++) dy[j] = sinf((float)j);
+  for (int k = 0; k < 20; k++) {
+    for (int i = 0; i < 8; i++) x[i] = cosf((float)(i + k) * 0.3f);
+    lora_notch_step(L3, x, dy, 1.0f);
+  }
+  int k3 = lora_compact(L3, 1.0f);
+  ASSERT(k3 < 4, "single-pattern delta compacts");
+  LoRA* fresh = lora_new(8, 16, k3, 1.0f, 0.1f, 0.0f, 9);
+  ASSERT(lora_get_bytes(L3) == lora_get_bytes(fresh), "buffers shrunk to the new rank");
+  lora_free(fresh);
+  size_t before = lora_pool_bytes(P);
+  ASSERT(lora_pool_add(P, 3, L3) == 0, "re-add resident adapter");
+  ASSERT(lora_pool_bytes(P) == before - one + lora_get_bytes(L3), "released bytes re-accounted");
+  ASSERT(lora_pool_count(P) == 3, "re-add evicts nothing");
+
+  LoRA* big = lora_new(8, 16, 64, 1.0f, 0.1f, 0.0f, 9);
+  ASSERT(lora_pool_add(P, 9, big) == 1, "adapter larger than budget is rejected");
+  lora_free(big);
+
+  lora_pool_free(P);
+  PASS();
+}
+
+void test_pool_apply_batch(void) {
+  enum { IN = 10, OUT = 40, N = 50, NA = 4 };
+  LoRAPool* P = lora_pool_new(IN, OUT, 0);
+  LoRA* ref[NA];
+  float x0[IN], dy[OUT];
+  for (int i = 0; i < IN; i++) x0[i] = (float)i * 0.1f;
+  for (int j = 0; j < OUT; j++) dy[j] = (j % 3) - 1.0f;
+  for (int a = 0; a < NA; a++) {
+    ref[a] = lora_new(IN, OUT, 4 + 4 * (a % 2), 1.0f, 0.1f, 0.0f, 50 + a);
+    lora_notch_step(ref[a], x0, dy, 0.5f + 0.1f * a);
+    lora_pool_add(P, 100 + a, ref[a]);
+  }
+
+  float X[N * IN], Y[N * OUT], R[N * OUT];
+  int ids[N];
+  for (int k = 0; k < N * IN; k++) X[k] = cosf((float)k * 0.21f);
+  for (int k = 0; k < N * OUT; k++) Y[k] = R[k] = 0.5f;
+  for (int b = 0; b < N; b++) ids[b] = (b % 6 == 5) ? -1 : (b % 6 == 4 ? 999 : 100 + (b * 7) % NA);
+
+  int hit = lora_pool_apply_batch(P, X, Y, ids, N);
+  int expect = 0;
+  for (int b = 0; b < N; b++) {
+    if (ids[b] < 100 || ids[b] >= 100 + NA) continue;
+    lora_apply(ref[ids[b] - 100], X + b * IN, R + b * OUT);
+    expect++;
+  }
+  ASSERT(hit == expect, "rows with unknown or negative ids are skipped");
+  ASSERT(memcmp(Y, R, sizeof(Y)) == 0, "grouped apply should equal per-row apply");
+
+  lora_pool_free(P);  // owns ref[]
+  PASS();
+}
+
+static void matvec_in_out(const float* W, int ld, const float* x, float* y, int in, int out) {
+  for (int j = 0; j < out; j++) y[j] = 0.0f;
+  for (int i = 0; i < in; i++)
+    for (int j = 0; j < out; j++) y[j] += x[i] * W[i * ld + j];
+}
+
+void test_fold_unfold(void) {
+  enum { IN = 12, OUT = 30, LD = 40 };  // strided like a reserved Wo
+  for (int layout = 0; layout < 2; layout++) {
+    LoRA* L = lora_new(IN, OUT, 4, 2.0f, 0.2f, 0.0f, 8080);
+    float x[IN], dy[OUT];
+    for (int i = 0; i < IN; i++) x[i] = sinf((float)i + 0.5f);
+    for (int j = 0; j < OUT; j++) dy[j] = (j % 5 == 0) ? 1.0f : -0.1f;
+    lora_notch_step(L, x, dy, 1.0f);
+
+    int rows = layout == 0 ? IN : OUT;
+    float W[OUT * LD], W0[OUT * LD], Wt[IN * OUT];
+    for (int k = 0; k < rows * LD; k++) W[k] = W0[k] = cosf((float)k * 0.13f);
+
+    ASSERT(lora_fold_into(L, W, layout, LD) == 0, "fold should succeed");
+    ASSERT(lora_is_folded(L) && !lora_is_dirty(L), "folded and clean");
+    ASSERT(lora_fold_into(L, W, layout, LD) == 1, "double fold should fail");
+    for (int k = 0; k < rows * LD; k++) {
+      if (k % LD >= (layout == 0 ? OUT : IN)) ASSERT(W[k] == W0[k], "padding must not be touched");
+    }
+
+    // x·W_folded == x·W0 + lora_apply(x)
+    float y[OUT], ref[OUT];
+    for (int i = 0; i < IN; i++)
+      for (int j = 0; j < OUT; j++)
+        Wt[i * OUT + j] = layout == 0 ? W[i * LD + j] : W[j * LD + i];
+    matvec_in_out(Wt, OUT, x, y, IN, OUT);
+    for (int i = 0; i < IN; i++)
+      for (int j = 0; j < OUT; j++)
+        Wt[i * OUT + j] = layout == 0 ? W0[i * LD + j] : W0[j * LD + i];
+    matvec_in_out(Wt, OUT, x, ref, IN, OUT);
+    lora_apply(L, x, ref);
+    for (int j = 0; j < OUT; j++) ASSERT_CLOSE(y[j], ref[j], 1e-4f, "folded W should include the delta");
+
+    // learning while folded marks dirty; refold tracks the new factors
+    lora_notch_step(L, x, dy, 1.0f);
+    ASSERT(lora_is_dirty(L), "notch step should mark dirty");
+    ASSERT(lora_refold(L) == 0 && !lora_is_dirty(L), "refold cleans");
+    for (int i = 0; i < IN; i++)
+      for (int j = 0; j < OUT; j++)
+        Wt[i * OUT + j] = layout == 0 ? W[i * LD + j] : W[j * LD + i];
+    matvec_in_out(Wt, OUT, x, y, IN, OUT);
+    for (int i = 0; i < IN; i++)
+      for (int j = 0; j < OUT; j++)
+        Wt[i * OUT + j] = layout == 0 ? W0[i * LD + j] : W0[j * LD + i];
+    matvec_in_out(Wt, OUT, x, ref, IN, OUT);
+    lora_apply(L, x, ref);
+    for (int j = 0; j < OUT; j++) ASSERT_CLOSE(y[j], ref[j], 1e-4f, "refold should include the new delta");
+
+    ASSERT(lora_unfold_from(L, W, 1 - layout) == 1, "wrong layout should fail");
+    ASSERT(lora_unfold_from(L, W, layout) == 0, "unfold should succeed");
+    ASSERT(memcmp(W, W0, sizeof(float) * rows * LD) == 0, "unfold should restore W exactly");
+    ASSERT(!lora_is_folded(L), "no longer folded");
+    lora_free(L);
+  }
+  PASS();
+}
+
+static int factors_equal(LoRA* a, LoRA* b) {
+  // factor_ptrs folds the lazy scale into both, so compare true factors
+  float *Aa, *Ba, *Ab, *Bb;
+  int nA, nB;
+  lora_get_factor_ptrs(a, &Aa, &Ba, &nA, &nB);
+  lora_get_factor_ptrs(b, &Ab, &Bb, NULL, NULL);
+  return memcmp(Aa, Ab, sizeof(float) * nA) == 0 && memcmp(Ba, Bb, sizeof(float) * nB) == 0;
+}
+
+void test_shard_save_load(void) {
+  const char* path = "test_lora_a.shard";
+  LoRA* L = lora_new(16, 50, 4, 1.5f, 0.05f, 0.01f, 31);
+  float x[16], probs[50];
+  for (int i = 0; i < 16; i++) x[i] = sinf((float)i);
+  for (int j = 0; j < 50; j++) probs[j] = (float)((j * 13) % 17) / 100.0f;
+  for (int k = 0; k < 5; k++) lora_experience_step(L, x, probs, k * 7, 0.8f, 1.0f, 0.5f, 3);
+
+  ASSERT(lora_save(L, path) == 0, "save should succeed");
+  ASSERT(lora_shard_log_count(path) == 0, "fresh shard has an empty log");
+  LoRA* M = lora_load_mmap(path);
+  ASSERT(M != NULL, "load should succeed");
+
+  float p1[7], p2[7];
+  lora_copy_params(L, p1);
+  lora_copy_params(M, p2);
+  for (int k = 0; k < 7; k++) ASSERT(p1[k] == p2[k], "params should round-trip");
+
+  float y1[50] = {0}, y2[50] = {0};
+  lora_apply(L, x, y1);
+  lora_apply(M, x, y2);
+  ASSERT(memcmp(y1, y2, sizeof(y1)) == 0, "mapped adapter applies identically");
+
+  // same RNG state too: one more step stays in lockstep
+  lora_experience_step(L, x, probs, 3, 0.5f, 1.0f, 0.5f, 3);
+  lora_experience_step(M, x, probs, 3, 0.5f, 1.0f, 0.5f, 3);
+  ASSERT(factors_equal(L, M), "learning on the mapped adapter matches");
+
+  // learning on the mapping never writes the file
+  LoRA* N = lora_load_mmap(path);
+  float y3[50] = {0};
+  lora_apply(N, x, y3);
+  ASSERT(memcmp(y1, y3, sizeof(y1)) == 0, "file unchanged by copy-on-write learning");
+
+  // compacting a mapped adapter moves its factors to the heap
+  int k = lora_compact(N, 1.0f);
+  float y4[50] = {0}, sc;
+  lora_apply(N, x, y4);
+  ASSERT(k <= 4 && max_abs_diff(y4, y1, 50, &sc) <= 1e-4f * sc, "mapped adapter compacts");
+
+  FILE* f = fopen(path, "r+b");
+  fputc('X', f);
+  fclose(f);
+  ASSERT(lora_load_mmap(path) == NULL, "bad magic should be rejected");
+
+  lora_free(L); lora_free(M); lora_free(N);
+  remove(path);
+  PASS();
+}
+
+void test_shard_replay(void) {
+  const char* path = "test_lora_b.shard";
+  LoRA* L = lora_new(12, 40, 4, 1.0f, 0.05f, 0.02f, 77);
+  ASSERT(lora_save(L, path) == 0, "save base");
+  ASSERT(lora_shard_record(L, path) == 0, "start recording");
+
+  float x[12], probs[40];
+  for (int k = 0; k < 20; k++) {
+    for (int i = 0; i < 12; i++) x[i] = cosf((float)(i * k) * 0.1f);
+    for (int j = 0; j < 40; j++) probs[j] = (float)(((j + k) * 31) % 23) / 50.0f;
+    lora_experience_step(L, x, probs, (k * 11) % 40, 0.3f + 0.05f * k, 1.0f, 0.5f, k % 4);
+    lora_clamp_factors(L, 0.05f);  // the UI's clamp-after-step loop
+  }
+  lora_soft_reset(L, 0.8f);
+  ASSERT(lora_shard_record(L, NULL) == 0, "stop recording");
+  int logged = lora_shard_log_count(path);
+  ASSERT(logged > 21, "experiences and scales logged");
+
+  // the base factors + replay reproduce the session exactly
+  LoRA* R = lora_load_mmap(path);
+  ASSERT(R != NULL, "load base");
+  ASSERT(lora_replay(R, path, 0, 5) == 5, "partial replay");
+  ASSERT(lora_replay(R, path, 5, -1) == logged - 5, "replay to end");
+  ASSERT(factors_equal(L, R), "replayed adapter should equal the trained one");
+
+  // a torn tail is ignored and overwritten by the next record
+  FILE* f = fopen(path, "ab");
+  fwrite("torn", 1, 4, f);
+  fclose(f);
+  ASSERT(lora_shard_log_count(path) == logged, "torn record not counted");
+  ASSERT(lora_shard_record(L, path) == 0, "reopen for recording");
+  lora_experience_step(L, x, probs, 1, 0.5f, 1.0f, 0.5f, 2);
+  lora_shard_record(L, NULL);
+  ASSERT(lora_shard_log_count(path) == logged + 1, "append after torn tail");
+
+  LoRA* wrong = lora_new(13, 40, 4, 1.0f, 0.05f, 0.0f, 1);
+  ASSERT(lora_shard_record(wrong, path) == 1, "dims mismatch rejected");
+  ASSERT(lora_replay(wrong, path, 0, -1) == -1, "replay dims mismatch rejected");
+  lora_free(wrong);
+
+  lora_free(L); lora_free(R);
+  remove(path);
+  PASS();
+}
+
+void test_learner(void) {
+  enum { IN = 16, OUT = 64, N = 50 };
+  LoRA* M = lora_new(IN, OUT, 4, 1.0f, 0.05f, 0.01f, 4321);
+  LoRA* R = lora_new(IN, OUT, 4, 1.0f, 0.05f, 0.01f, 4321);
+  LoRALearner* Ln = lora_learner_new(M, 64, 8);
+  ASSERT(Ln != NULL, "learner_new failed");
+
+  LoRA* S = lora_learner_acquire(Ln);
+  ASSERT(lora_learner_epoch(Ln) == 0, "nothing published before the first push");
+  ASSERT(factors_equal(S, R), "epoch 0 holds the starting factors");
+
+  float x[IN], probs[OUT];
+  for (int k = 0; k < N; k++) {
+    for (int i = 0; i < IN; i++) x[i] = sinf((float)(i + k) * 0.3f);
+    for (int j = 0; j < OUT; j++) probs[j] = (float)(((j + 3 * k) * 29) % 31) / 40.0f;
+    int target = (k * 13) % OUT;
+    ASSERT(lora_learner_push(Ln, x, probs, target, 0.6f, 1.0f, 0.5f, 3) == 1, "push should queue");
+    lora_experience_step(R, x, probs, target, 0.6f, 1.0f, 0.5f, 3);
+    lora_learner_acquire(Ln);  // readers may poll at any time
+  }
+  lora_learner_flush(Ln);
+  ASSERT(lora_learner_steps(Ln) == N && lora_learner_dropped(Ln) == 0, "all experiences applied");
+
+  S = lora_learner_acquire(Ln);
+  ASSERT(lora_learner_epoch(Ln) == 7, "50 steps / 8 -> 6 publishes + flush");
+  ASSERT(factors_equal(S, R), "published snapshot equals synchronous learning");
+
+  int bad[2] = {OUT + 1, 0};
+  float v[2] = {1.0f, 1.0f};
+  ASSERT(lora_learner_push_sparse(Ln, x, bad, v, 40, 1.0f) == 0, "too many pairs rejected");
+
+  lora_learner_free(Ln);
+  ASSERT(factors_equal(M, R), "master returned with every step applied");
+  lora_free(M);
+  lora_free(R);
+  PASS();
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // Main
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -358,24 +1027,46 @@ int main(void) {
   TEST(apply_zero_init);
   TEST(apply_after_step);
   TEST(apply_alpha);
+  TEST(apply_kernels);
+  TEST(apply_batch);
   
   printf("\n3. Notorch Step\n\n");
   TEST(notch_step_changes_factors);
   TEST(decay);
+  TEST(notch_step_sparse);
+  TEST(experience_step_sparse);
   
   printf("\n4. Scaling & Clamping\n\n");
   TEST(scale);
   TEST(clamp_factors);
   TEST(soft_reset);
+  TEST(lazy_decay);
+  TEST(scale_underflow_fold);
+  TEST(running_norms);
+  TEST(compact);
+  TEST(compact_energy);
   
   printf("\n5. Merge & Helpers\n\n");
   TEST(merge);
   TEST(build_dy_from_probs);
   TEST(copy_params);
   TEST(get_factor_norms);
+  TEST(fold_unfold);
   
   printf("\n6. Determinism\n\n");
   TEST(set_seed_determinism);
+
+  printf("\n7. Adapter Pool\n\n");
+  TEST(pool_registry);
+  TEST(pool_lru_budget);
+  TEST(pool_apply_batch);
+
+  printf("\n8. Shards\n\n");
+  TEST(shard_save_load);
+  TEST(shard_replay);
+
+  printf("\n9. Background Learner\n\n");
+  TEST(learner);
   
   printf("\n════════════════════════════════════════════════════════════\n");
   printf("\n📊 Results: %d passed, %d failed\n\n", passed, failed);
@@ -3,6 +3,8 @@
 //
 // Contains:
 //   - AriannaLung: bidirectional transformer (the breathing organ)
+//   - AriannaVoice: causal multi-layer transformer over the personality
+//     weights (the inner voice)
 //   - [future: other organs as the field grows]
 //
 // This is what makes ariannamethod.lang a TRUE DSL AI:
@@ -16,11 +18,27 @@
 // הרזוננס לא נשבר. המשך הדרך.
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// -DLUNG_PROFILE: per-phase timers and byte counters (lung_get_profile).
+// Natively they read clock_gettime, which strict C99 hides without this.
+#if defined(LUNG_PROFILE) && !defined(__EMSCRIPTEN__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
 
+#if defined(LUNG_PROFILE) && !defined(__EMSCRIPTEN__)
+#include <time.h>
+#endif
+
+// -DLUNG_THREADS: lung_pipeline_* run the forward on a worker thread
+// (pthreads natively; Web Workers over SharedArrayBuffer under emcc -pthread)
+#ifdef LUNG_THREADS
+#include <pthread.h>
+#endif
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #define EXPORT EMSCRIPTEN_KEEPALIVE
@@ -58,6 +76,22 @@ extern "C" {
 // Random initialization scale
 #define INIT_SCALE                    0.08f
 
+// Arena alignment: every buffer starts on a cache line / SIMD boundary
+#define LUNG_ALIGN                    64
+
+// Profiled phases of a breath (-DLUNG_PROFILE, see PROFILE)
+enum {
+  LUNG_PHASE_EMBED,         // slot tokens, token K/V projection, query
+  LUNG_PHASE_QK,            // q·k scoring (head kernels)
+  LUNG_PHASE_SOFTMAX,       // score physics + attention softmax, output softmax
+  LUNG_PHASE_VALUE,         // Σ w·v accumulate (head kernels)
+  LUNG_PHASE_PROJECTION,    // logits = Wo^T · y
+  LUNG_PHASE_MODULATION,    // presence on logits, presence decay/pulse
+  LUNG_PHASE_ENTROPY,
+  LUNG_PHASE_TOPK,          // lung_get_top_k / lung_top_k_approx
+  LUNG_PROFILE_PHASES
+};
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // ARIANNA LUNG — THE BREATHING ORGAN (bidirectional transformer)
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -73,28 +107,114 @@ extern "C" {
 //
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// The lung is split in two:
+//   - LungWeights: immutable, refcounted model (E, Wo, Wq/Wk/Wv, positions)
+//   - LungSession: per-field breathing state (resonance, presence, physics,
+//                  inference state, work buffers)
+//
+// Many sessions may share one LungWeights. A server hosting hundreds of
+// fields over the same model pays for the weights once.
+//
+// AriannaLung is a LungSession: lung_create() builds a private weight set
+// and a session over it, so the single-tenant API is unchanged.
+
+// Inner-product index over the Wo columns (built lazily, see APPROXIMATE TOP-K)
+typedef struct {
+  void* arena;         // one aligned block holding every index array
+  int version;         // weights version the index was built against
+  int n_clusters;
+  float* centroids;    // n_clusters × d_model: mean column of each cluster
+  float* radius;       // n_clusters: max ||column - centroid|| in the cluster
+  int* offsets;        // n_clusters + 1: cluster c owns members[offsets[c]..offsets[c+1])
+  int* members;        // vocab_size: token ids grouped by cluster
+  float* cols;         // vocab_size × d_model: Wo columns packed in member order
+} LungMipsIndex;
+
 typedef struct {
+  int refcount;        // sessions + external holders (lung_weights_retain)
+  void* arena;         // one aligned block holding every fixed-size weight array
+  void* vocab_arena;   // one aligned block holding the vocab-sized arrays (E, Wo, flags)
+
   // ─────────────────────────────────────────────────────────────────────────────
   // DIMENSIONS
   // ─────────────────────────────────────────────────────────────────────────────
   int vocab_size;      // vocabulary size
+  int vocab_cap;       // rows reserved in the vocab block (>= vocab_size)
   int d_model;         // embedding dimension
   int ctx_len;         // context length
   int n_heads;         // number of attention heads
+  int n_kv_heads;      // K/V heads: query head h reads group h / (n_heads / n_kv_heads)
   int head_dim;        // dimension per head (d_model / n_heads)
+  int kv_dim;          // n_kv_heads × head_dim: width of a K or V row
 
   // ─────────────────────────────────────────────────────────────────────────────
   // WEIGHTS (flat arrays for WASM efficiency)
   // ─────────────────────────────────────────────────────────────────────────────
-  float* E;            // embeddings: vocab_size × d_model
+  float* E;            // embeddings: vocab_cap × d_model
   float* P_ltr;        // positional encoding LTR: ctx_len × d_model
   float* P_rtl;        // positional encoding RTL: ctx_len × d_model (PITOMADOM)
-  float* Wo;           // output projection: d_model × vocab_size
+  float* Wo;           // output projection: d_model × vocab_cap (row stride vocab_cap)
 
   // Multi-head attention weights (contiguous blocks)
   float* Wq;           // query: n_heads × (head_dim × d_model)
-  float* Wk;           // key:   n_heads × (head_dim × d_model)
-  float* Wv;           // value: n_heads × (head_dim × d_model)
+  float* Wk;           // key:   n_kv_heads × (head_dim × d_model)
+  float* Wv;           // value: n_kv_heads × (head_dim × d_model)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // POSITIONAL PROJECTIONS — K and V are linear in X = E[tok] + P[t], so
+  // Wk·X = Wk·E[tok] + Wk·P[t]. The position half is fixed per weight set.
+  // ─────────────────────────────────────────────────────────────────────────────
+  float* KP_ltr;       // ctx_len × kv_dim: Wk · P_ltr[t]
+  float* KP_rtl;       // ctx_len × kv_dim: Wk · P_rtl[t]
+  float* VP_ltr;       // ctx_len × kv_dim: Wv · P_ltr[t]
+  float* VP_rtl;       // ctx_len × kv_dim: Wv · P_rtl[t]
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // ROTARY TABLES — angle of every (relative offset, frequency) pair
+  // ─────────────────────────────────────────────────────────────────────────────
+  float* rope_cos;     // ctx_len × (head_dim / 2): cos(r · θ_i)
+  float* rope_sin;     // ctx_len × (head_dim / 2): sin(r · θ_i)
+
+  int version;         // bumped by lung_weights_touch() after in-place edits
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // INITIALIZATION — counter-based, so every row is a pure function of
+  // (seed, token) and lazy weights fill rows on first touch
+  // ─────────────────────────────────────────────────────────────────────────────
+  uint32_t seed;       // weight stream seed
+  uint8_t* e_ready;    // vocab_cap: row of E materialized
+  uint8_t* wo_ready;   // vocab_cap: column of Wo materialized
+  int e_complete;      // every E row materialized (eager weights start here)
+  int wo_complete;     // every Wo column materialized
+  int lazy;            // rows of grown tokens wait for first touch too
+
+  LungMipsIndex* mips; // approximate top-k index (NULL until first used)
+
+} LungWeights;
+
+typedef struct LungPipeline LungPipeline;  // see PIPELINE
+struct LungSession;
+
+// Per-head attention kernels, specialized by head_dim (see HEAD KERNELS)
+typedef void (*LungScoreKernel)(const struct LungSession* lung, const float* q, int kvoff, float* raw);
+typedef void (*LungValueKernel)(const struct LungSession* lung, const float* w, int kvoff, float* out);
+
+typedef struct LungSession {
+  LungWeights* w;      // shared weights (one reference held by this session)
+  void* arena;         // one aligned block holding every fixed-size per-session array
+  void* vocab_arena;   // one aligned block holding the vocab-sized arrays
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // DIMENSIONS (mirrored from weights for the hot path)
+  // ─────────────────────────────────────────────────────────────────────────────
+  int vocab_size;
+  int vocab_cap;            // entries reserved in the vocab block (>= vocab_size)
+  int d_model;
+  int ctx_len;
+  int n_heads;
+  int n_kv_heads;
+  int head_dim;
+  int kv_dim;
 
   // ─────────────────────────────────────────────────────────────────────────────
   // NOTORCH — resonance learning without backprop
@@ -113,6 +233,7 @@ typedef struct {
   // PITOMADOM TEMPORAL SYMMETRY
   // ─────────────────────────────────────────────────────────────────────────────
   int use_rtl;              // 0 = LTR (standard), 1 = RTL (Hebrew mode)
+  int use_rotary;           // 0 = absolute sinusoidal P, 1 = rotary (relative)
   float temporal_alpha;     // 0..1: 0=past, 0.5=symmetric, 1=future
   // temporal_alpha > 0.5 = prophecy mode (emphasize future)
   // temporal_alpha < 0.5 = retrodiction mode (emphasize past)
@@ -123,16 +244,51 @@ typedef struct {
   float* last_logits;       // vocab_size: raw logits from last forward
   float* last_probs;        // vocab_size: probabilities from last forward
   float* last_attention;    // ctx_len: combined attention weights
+  float* last_hidden;       // d_model: attention output feeding Wo
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // TOKEN K/V CACHE — per-slot Wk·E[tok], Wv·E[tok] of the last window.
+  // A sliding window shifts the rows instead of recomputing them.
+  // ─────────────────────────────────────────────────────────────────────────────
+  int* kv_tok;              // ctx_len: token cached in each slot (-1 = empty)
+  float* KE;                // ctx_len × kv_dim
+  float* VE;                // ctx_len × kv_dim
+  int kv_version;           // weights version the cache was built against
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // PROPHECY — rolling window and sampling state for lung_prophesy()
+  // ─────────────────────────────────────────────────────────────────────────────
+  int* window;              // ctx_len: rolling context for multi-step rollouts
+  uint32_t sample_state;    // xorshift state for sampled decoding
+
+  LungPipeline* pipe;       // async double-buffered forward (NULL until first submit)
 
   // ─────────────────────────────────────────────────────────────────────────────
   // WORK BUFFERS (pre-allocated for efficiency)
   // ─────────────────────────────────────────────────────────────────────────────
-  float* X;                 // ctx_len × d_model: token vectors with positional
+  int* slot_tok;            // ctx_len: clamped token per slot
+  float* slot_res;          // ctx_len: resonance multiplier per slot
+  const float** k_rows;     // ctx_len: token-half K row feeding each slot
+  const float** v_rows;     // ctx_len: token-half V row feeding each slot
+  float* x_last;            // d_model: E[last] + P[last]
+  float* q;                 // n_heads × head_dim: queries of the last position
   float* scores;            // ctx_len: attention scores
   float* head_out;          // head_dim: single head output
   float* y;                 // d_model: concatenated head outputs
+  float* rank_val;          // vocab_size: running top-k scores
+  float* cluster_ub;        // mips clusters: score upper bound per cluster
+  int* cluster_order;       // mips clusters: scan order
+
+  LungScoreKernel score_kernel;   // q·k per slot for one head
+  LungValueKernel value_kernel;   // Σ w[t]·v_t for one head
+
+#ifdef LUNG_PROFILE
+  double profile[LUNG_PROFILE_PHASES * 3];  // per phase: ns, bytes, calls
+#endif
+
+} LungSession;
 
-} AriannaLung;
+typedef LungSession AriannaLung;
 
 // ═══════════════════════════════════════════════════════════════════════════════
 // MATH UTILITIES
@@ -159,6 +315,21 @@ static float dot(const float* a, const float* b, int n) {
   return sum;
 }
 
+// Dot product over 4 independent accumulators: no serial dependency chain,
+// so the lanes map onto SIMD registers. With a literal n it fully unrolls.
+static inline float dot4(const float* a, const float* b, int n) {
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; i++) s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
 // Matrix-vector multiply: out[rows] = mat[rows × cols] × vec[cols]
 static void mat_vec(float* out, const float* mat, const float* vec, int rows, int cols) {
   for (int i = 0; i < rows; i++) {
@@ -166,12 +337,13 @@ static void mat_vec(float* out, const float* mat, const float* vec, int rows, in
   }
 }
 
-// Transposed matrix-vector: out[cols] = mat[rows × cols]^T × vec[rows]
-static void mat_vec_t(float* out, const float* mat, const float* vec, int rows, int cols) {
+// Transposed matrix-vector: out[cols] = mat[rows × cols]^T × vec[rows],
+// rows of mat laid out `stride` floats apart (stride >= cols)
+static void mat_vec_t(float* out, const float* mat, const float* vec, int rows, int cols, int stride) {
   for (int j = 0; j < cols; j++) {
     float sum = 0.0f;
     for (int i = 0; i < rows; i++) {
-      sum += mat[i * cols + j] * vec[i];
+      sum += mat[(size_t)i * stride + j] * vec[i];
     }
     out[j] = sum;
   }
@@ -196,8 +368,22 @@ static void softmax(float* x, int n) {
   }
 }
 
-// AXPY: y += a * x
-static void axpy(float* y, const float* x, float a, int n) {
+// Rotary dot: (R(dir · φ) q) · k, φ_i per pair from cos/sin tables.
+// An odd trailing dimension is left unrotated.
+static inline float rope_dot(const float* q, const float* k, const float* c, const float* s, int n, float dir) {
+  float sum = 0.0f;
+  int half = n / 2;
+  for (int i = 0; i < half; i++) {
+    float q0 = q[2 * i], q1 = q[2 * i + 1];
+    float sn = dir * s[i];
+    sum += (q0 * c[i] - q1 * sn) * k[2 * i] + (q0 * sn + q1 * c[i]) * k[2 * i + 1];
+  }
+  if (n & 1) sum += q[n - 1] * k[n - 1];
+  return sum;
+}
+
+// AXPY: y += a * x (y and x must not overlap)
+static void axpy(float* restrict y, const float* restrict x, float a, int n) {
   for (int i = 0; i < n; i++) {
     y[i] += a * x[i];
   }
@@ -220,95 +406,636 @@ static void build_positional_encoding(float* P, int ctx, int d, int rtl) {
   }
 }
 
+// Rotary mode (lung_set_rotary): nothing is added to X. Queries and keys are
+// rotated by their position instead, so q·k depends only on the offset
+// r = last - t between the query slot and the key slot, never on where the
+// window sits. Token projections are position-free and survive any slide.
+// RTL rotates the other way (offset -r): the same distance, opposite arrow.
+static void build_rotary_tables(float* C, float* S, int ctx, int head_dim) {
+  int half = head_dim / 2;
+  for (int r = 0; r < ctx; r++) {
+    for (int i = 0; i < half; i++) {
+      float theta = powf(10000.0f, -(float)(2 * i) / (float)head_dim);
+      C[r * half + i] = cosf((float)r * theta);
+      S[r * half + i] = sinf((float)r * theta);
+    }
+  }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PROFILE — per-phase timers, compiled in with -DLUNG_PROFILE
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// Each phase of a breath accumulates wall time (ns), an estimate of the
+// bytes it reads and writes (weights, caches, vocab arrays — what decides
+// whether it is memory bound) and a call count. Phases nest nowhere, so
+// a function times its phases back to back:
+//
+//   LUNG_PROF_START();
+//   ...embedding...   LUNG_PROF_LAP(lung, LUNG_PHASE_EMBED, bytes);
+//   ...scores...      LUNG_PROF_LAP(lung, LUNG_PHASE_QK, bytes);
+//
+// Without the flag the macros are empty and the session carries no
+// counters: zero cost. Timers: emscripten_get_now() in WASM (its
+// resolution may be coarsened by the browser), clock_gettime natively.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifdef LUNG_PROFILE
+
+static double lung_now_ns(void) {
+#ifdef __EMSCRIPTEN__
+  return emscripten_get_now() * 1e6;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static void lung_prof_add(LungSession* lung, int phase, double ns, double bytes) {
+  double* p = lung->profile + phase * 3;
+  p[0] += ns;
+  p[1] += bytes;
+  p[2] += 1.0;
+}
+
+#define LUNG_PROF_START()  double prof_t0_ = lung_now_ns()
+#define LUNG_PROF_LAP(lung, phase, bytes)                  \
+  do {                                                     \
+    double prof_t1_ = lung_now_ns();                       \
+    lung_prof_add((lung), (phase), prof_t1_ - prof_t0_, (double)(bytes)); \
+    prof_t0_ = prof_t1_;                                   \
+  } while (0)
+
+#else
+
+#define LUNG_PROF_START()                  ((void)0)
+#define LUNG_PROF_LAP(lung, phase, bytes)  ((void)0)
+
+#endif
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// ARENA — one aligned allocation per object
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// Every float array of a LungWeights / LungSession is carved from a single
+// LUNG_ALIGN-aligned block. The same layout function runs twice: once with
+// no base to measure the block, once to hand out pointers. Allocation either
+// fully succeeds or fully fails, and destroy is a single free.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  char* base;          // NULL while measuring
+  size_t used;         // bytes consumed so far (aligned)
+} LungArena;
+
+static size_t lung_align_up(size_t n) {
+  return (n + (LUNG_ALIGN - 1)) & ~(size_t)(LUNG_ALIGN - 1);
+}
+
+static float* arena_floats(LungArena* a, size_t n) {
+  float* p = a->base ? (float*)(a->base + a->used) : NULL;
+  a->used += lung_align_up(n * sizeof(float));
+  return p;
+}
+
+static int* arena_ints(LungArena* a, size_t n) {
+  int* p = a->base ? (int*)(a->base + a->used) : NULL;
+  a->used += lung_align_up(n * sizeof(int));
+  return p;
+}
+
+static uint8_t* arena_bytes(LungArena* a, size_t n) {
+  uint8_t* p = a->base ? (uint8_t*)(a->base + a->used) : NULL;
+  a->used += lung_align_up(n);
+  return p;
+}
+
+static const float** arena_rows(LungArena* a, size_t n) {
+  const float** p = a->base ? (const float**)(a->base + a->used) : NULL;
+  a->used += lung_align_up(n * sizeof(const float*));
+  return p;
+}
+
+// calloc'd and aligned by hand (portable to C99 and emscripten);
+// *raw receives the pointer to free()
+static char* lung_arena_alloc(size_t bytes, void** raw) {
+  void* p = calloc(1, bytes + LUNG_ALIGN);
+  *raw = p;
+  if (!p) return NULL;
+  uintptr_t aligned = ((uintptr_t)p + (LUNG_ALIGN - 1)) & ~(uintptr_t)(LUNG_ALIGN - 1);
+  return (char*)aligned;
+}
+
+// ~sqrt(vocab) clusters: scanning the centroids costs as much as one cluster
+static int lung_mips_clusters(int vocab_size) {
+  int nc = (int)(sqrtf((float)vocab_size) + 0.5f);
+  return (nc < 1) ? 1 : nc;
+}
+
+static void lung_weights_layout(LungWeights* w, LungArena* a) {
+  size_t d = (size_t)w->d_model;
+  size_t ctx = (size_t)w->ctx_len;
+  size_t heads_size = (size_t)w->n_heads * (size_t)w->head_dim * d;
+  size_t kv_size = (size_t)w->kv_dim * d;
+
+  w->P_ltr = arena_floats(a, ctx * d);
+  w->P_rtl = arena_floats(a, ctx * d);
+  w->Wq = arena_floats(a, heads_size);
+  w->Wk = arena_floats(a, kv_size);
+  w->Wv = arena_floats(a, kv_size);
+
+  size_t kvd = (size_t)w->kv_dim;
+  w->KP_ltr = arena_floats(a, ctx * kvd);
+  w->KP_rtl = arena_floats(a, ctx * kvd);
+  w->VP_ltr = arena_floats(a, ctx * kvd);
+  w->VP_rtl = arena_floats(a, ctx * kvd);
+
+  size_t half = (size_t)(w->head_dim / 2);
+  w->rope_cos = arena_floats(a, ctx * half);
+  w->rope_sin = arena_floats(a, ctx * half);
+}
+
+// Everything sized by the vocabulary lives in its own block, laid out for
+// vocab_cap tokens, so growth within capacity touches only the new rows
+static void lung_weights_vocab_layout(LungWeights* w, LungArena* a) {
+  size_t cap = (size_t)w->vocab_cap;
+  size_t d = (size_t)w->d_model;
+
+  w->E = arena_floats(a, cap * d);
+  w->Wo = arena_floats(a, d * cap);
+  w->e_ready = arena_bytes(a, cap);
+  w->wo_ready = arena_bytes(a, cap);
+}
+
+static void lung_session_layout(LungSession* lung, LungArena* a) {
+  size_t d = (size_t)lung->d_model;
+  size_t ctx = (size_t)lung->ctx_len;
+
+  // Inference state
+  lung->last_attention = arena_floats(a, ctx);
+  lung->last_hidden = arena_floats(a, d);
+
+  // Token K/V cache
+  size_t qkv = (size_t)lung->n_heads * (size_t)lung->head_dim;
+  lung->kv_tok = arena_ints(a, ctx);
+  lung->KE = arena_floats(a, ctx * (size_t)lung->kv_dim);
+  lung->VE = arena_floats(a, ctx * (size_t)lung->kv_dim);
+
+  // Prophecy window
+  lung->window = arena_ints(a, ctx);
+
+  // Work buffers
+  lung->slot_tok = arena_ints(a, ctx);
+  lung->slot_res = arena_floats(a, ctx);
+  lung->k_rows = arena_rows(a, ctx);
+  lung->v_rows = arena_rows(a, ctx);
+  lung->x_last = arena_floats(a, d);
+  lung->q = arena_floats(a, qkv);
+  lung->scores = arena_floats(a, ctx);
+  lung->head_out = arena_floats(a, (size_t)lung->head_dim);
+  lung->y = arena_floats(a, d);
+}
+
+static void lung_session_vocab_layout(LungSession* lung, LungArena* a) {
+  size_t cap = (size_t)lung->vocab_cap;
+  size_t clusters = (size_t)lung_mips_clusters(lung->vocab_cap);
+
+  // Notorch arrays
+  lung->resonance = arena_floats(a, cap);
+  lung->presence_accum = arena_floats(a, cap);
+
+  // Inference state
+  lung->last_logits = arena_floats(a, cap);
+  lung->last_probs = arena_floats(a, cap);
+
+  // Work buffers
+  lung->rank_val = arena_floats(a, cap);
+  lung->cluster_ub = arena_floats(a, clusters);
+  lung->cluster_order = arena_ints(a, clusters);
+}
+
+static int lung_dims_valid(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  return vocab_size > 0 && d_model > 0 && ctx_len > 0 && n_heads > 0 && n_heads <= d_model;
+}
+
+// Query heads split evenly over the K/V heads
+static int lung_kv_heads_valid(int n_heads, int n_kv_heads) {
+  return n_kv_heads > 0 && n_kv_heads <= n_heads && n_heads % n_kv_heads == 0;
+}
+
+static size_t lung_weights_bytes(int vocab_size, int d_model, int ctx_len, int n_heads, int n_kv_heads) {
+  LungWeights w = {0};
+  LungArena a = {NULL, 0};
+  w.vocab_size = vocab_size;
+  w.vocab_cap = vocab_size;
+  w.d_model = d_model;
+  w.ctx_len = ctx_len;
+  w.n_heads = n_heads;
+  w.n_kv_heads = n_kv_heads;
+  w.head_dim = d_model / n_heads;
+  w.kv_dim = n_kv_heads * w.head_dim;
+  lung_weights_layout(&w, &a);
+  size_t fixed = a.used;
+  a.used = 0;
+  lung_weights_vocab_layout(&w, &a);
+  return fixed + LUNG_ALIGN + a.used;
+}
+
+static size_t lung_session_bytes(int vocab_size, int d_model, int ctx_len, int n_heads, int n_kv_heads) {
+  LungSession s = {0};
+  LungArena a = {NULL, 0};
+  s.vocab_size = vocab_size;
+  s.vocab_cap = vocab_size;
+  s.d_model = d_model;
+  s.ctx_len = ctx_len;
+  s.n_heads = n_heads;
+  s.n_kv_heads = n_kv_heads;
+  s.head_dim = d_model / n_heads;
+  s.kv_dim = n_kv_heads * s.head_dim;
+  lung_session_layout(&s, &a);
+  size_t fixed = a.used;
+  a.used = 0;
+  lung_session_vocab_layout(&s, &a);
+  return fixed + LUNG_ALIGN + a.used;
+}
+
+// Total footprint of lung_create(): weights + one session, headers included.
+// A further session over the same weights costs lung_session_required_bytes().
+EXPORT size_t lung_required_bytes(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  if (!lung_dims_valid(vocab_size, d_model, ctx_len, n_heads)) return 0;
+  return sizeof(LungWeights) + LUNG_ALIGN + lung_weights_bytes(vocab_size, d_model, ctx_len, n_heads, n_heads) +
+         sizeof(LungSession) + LUNG_ALIGN + lung_session_bytes(vocab_size, d_model, ctx_len, n_heads, n_heads);
+}
+
+EXPORT size_t lung_session_required_bytes(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  if (!lung_dims_valid(vocab_size, d_model, ctx_len, n_heads)) return 0;
+  return sizeof(LungSession) + LUNG_ALIGN + lung_session_bytes(vocab_size, d_model, ctx_len, n_heads, n_heads);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// HEAD KERNELS — per-head scoring and value accumulation
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// The two inner loops of attention, per head:
+//   scores: raw[t] = q·k_t / sqrt(head_dim)   (k = token half + position
+//           half, or the rotated form in rotary mode)
+//   values: out = Σ_t w[t] · v_t
+// LUNG_HEAD_KERNEL(NAME, HD) stamps out both for one head width. With HD a
+// literal (8, 16, 32, 64) every inner loop has a compile-time trip count, so
+// the compiler unrolls it and keeps q and the dot4 lanes in registers; the
+// generic instance reads HD from the session. Evaluation order is identical
+// in all instances — the specialized paths give bit-identical results.
+// lung_session_create() picks the instance matching head_dim.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LUNG_HEAD_KERNEL(NAME, HD)                                                        \
+static void lung_scores_##NAME(const LungSession* lung, const float* q, int kvoff, float* raw) { \
+  const LungWeights* W = lung->w;                                                         \
+  int ctx = lung->ctx_len;                                                                \
+  int kvd = lung->kv_dim;                                                                 \
+  int last_pos = ctx - 1;                                                                 \
+  float sqrt_head_dim = sqrtf((float)(HD));                                               \
+  if (lung->use_rotary) {                                                                 \
+    float dir = lung->use_rtl ? -1.0f : 1.0f;                                             \
+    int half = (HD) / 2;                                                                  \
+    for (int t = 0; t < ctx; t++) {                                                       \
+      int r = last_pos - t;                                                               \
+      raw[t] = rope_dot(q, lung->k_rows[t] + kvoff, W->rope_cos + r * half,               \
+                        W->rope_sin + r * half, (HD), dir) / sqrt_head_dim;               \
+    }                                                                                     \
+  } else {                                                                                \
+    const float* KP = lung->use_rtl ? W->KP_rtl : W->KP_ltr;                              \
+    for (int t = 0; t < ctx; t++) {                                                       \
+      const float* k = lung->k_rows[t] + kvoff;                                           \
+      const float* kp = KP + t * kvd + kvoff;                                             \
+      raw[t] = (dot4(q, k, (HD)) + dot4(q, kp, (HD))) / sqrt_head_dim;                    \
+    }                                                                                     \
+  }                                                                                       \
+}                                                                                         \
+static void lung_values_##NAME(const LungSession* lung, const float* w, int kvoff, float* restrict out) { \
+  int ctx = lung->ctx_len;                                                                \
+  int kvd = lung->kv_dim;                                                                 \
+  const float* VP = lung->use_rtl ? lung->w->VP_rtl : lung->w->VP_ltr;                    \
+  int rotary = lung->use_rotary;                                                          \
+  for (int i = 0; i < (HD); i++) out[i] = 0.0f;                                           \
+  for (int t = 0; t < ctx; t++) {                                                         \
+    const float* restrict v = lung->v_rows[t] + kvoff;                                    \
+    float a = w[t];                                                                       \
+    for (int i = 0; i < (HD); i++) out[i] += a * v[i];                                    \
+    if (!rotary) {                                                                        \
+      const float* restrict vp = VP + t * kvd + kvoff;                                    \
+      for (int i = 0; i < (HD); i++) out[i] += a * vp[i];                                 \
+    }                                                                                     \
+  }                                                                                       \
+}
+
+LUNG_HEAD_KERNEL(generic, lung->head_dim)
+LUNG_HEAD_KERNEL(8, 8)
+LUNG_HEAD_KERNEL(16, 16)
+LUNG_HEAD_KERNEL(32, 32)
+LUNG_HEAD_KERNEL(64, 64)
+
+static void lung_pick_kernels(LungSession* lung) {
+  switch (lung->head_dim) {
+    case 8:  lung->score_kernel = lung_scores_8;  lung->value_kernel = lung_values_8;  break;
+    case 16: lung->score_kernel = lung_scores_16; lung->value_kernel = lung_values_16; break;
+    case 32: lung->score_kernel = lung_scores_32; lung->value_kernel = lung_values_32; break;
+    case 64: lung->score_kernel = lung_scores_64; lung->value_kernel = lung_values_64; break;
+    default: lung->score_kernel = lung_scores_generic; lung->value_kernel = lung_values_generic; break;
+  }
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // INITIALIZATION
 // ═══════════════════════════════════════════════════════════════════════════════
 
-static void init_random_weights(float* w, int size, float scale) {
+// Counter-based weights: value i of a stream is hash(seed, stream, i), so
+// any row can be generated alone, in any order, on any thread, and a token's
+// row does not depend on vocab_size. Sessions still draw their resonance
+// from the sequential LCG above.
+#define LUNG_STREAM_E    1u
+#define LUNG_STREAM_WO   2u
+#define LUNG_STREAM_WQ   3u
+#define LUNG_STREAM_WK   4u
+#define LUNG_STREAM_WV   5u
+
+static float lung_hash_uniform(uint32_t seed, uint32_t stream, uint32_t index) {
+  // splitmix64 finalizer over (seed, stream, index)
+  uint64_t z = (((uint64_t)seed << 32) | stream) + (uint64_t)index * 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z ^= z >> 31;
+  return (float)(z >> 40) * (1.0f / 16777216.0f);  // [0, 1)
+}
+
+static void init_random_weights(float* w, int size, uint32_t seed, uint32_t stream, uint32_t base, float scale) {
   for (int i = 0; i < size; i++) {
     // Xavier-like: uniform in [-scale, scale]
-    w[i] = (2.0f * _randf() - 1.0f) * scale;
+    w[i] = (2.0f * lung_hash_uniform(seed, stream, base + (uint32_t)i) - 1.0f) * scale;
   }
 }
 
-EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_heads) {
-  AriannaLung* lung = (AriannaLung*)calloc(1, sizeof(AriannaLung));
-  if (!lung) return NULL;
+// ─────────────────────────────────────────────────────────────────────────────
+// LAZY ROWS — E rows and Wo columns generated on first touch
+// ─────────────────────────────────────────────────────────────────────────────
+//
+// Eager weights are born complete and these are single branches. Lazy ones
+// pay O(d) per token the first time it is embedded or scored; the full
+// projection (mat_vec_t over Wo) completes Wo on the first logits. Pages of
+// rows that are never touched are never written (native calloc keeps them
+// unbacked). Materialization writes the shared weights: sessions breathing
+// on other threads (LUNG_THREADS) should lung_weights_materialize() first.
+
+static const float* lung_e_row(LungWeights* w, int token_id) {
+  float* row = w->E + (size_t)token_id * w->d_model;
+  if (!w->e_complete && !w->e_ready[token_id]) {
+    init_random_weights(row, w->d_model, w->seed, LUNG_STREAM_E, (uint32_t)token_id * w->d_model, INIT_SCALE);
+    w->e_ready[token_id] = 1;
+  }
+  return row;
+}
 
-  // Store dimensions
-  lung->vocab_size = vocab_size;
-  lung->d_model = d_model;
-  lung->ctx_len = ctx_len;
-  lung->n_heads = n_heads;
-  lung->head_dim = d_model / n_heads;
+static void lung_wo_col(LungWeights* w, int token_id) {
+  if (w->wo_complete || w->wo_ready[token_id]) return;
+  int d = w->d_model;
+  int stride = w->vocab_cap;
+  for (int i = 0; i < d; i++) {
+    uint32_t index = (uint32_t)token_id * d + i;
+    w->Wo[(size_t)i * stride + token_id] = (2.0f * lung_hash_uniform(w->seed, LUNG_STREAM_WO, index) - 1.0f) * INIT_SCALE;
+  }
+  w->wo_ready[token_id] = 1;
+}
 
-  int head_weight_size = lung->head_dim * d_model;
+static void lung_e_all(LungWeights* w) {
+  if (w->e_complete) return;
+  for (int j = 0; j < w->vocab_size; j++) lung_e_row(w, j);
+  w->e_complete = 1;
+}
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Allocate weights
-  // ─────────────────────────────────────────────────────────────────────────────
-  lung->E = (float*)calloc(vocab_size * d_model, sizeof(float));
-  lung->P_ltr = (float*)calloc(ctx_len * d_model, sizeof(float));
-  lung->P_rtl = (float*)calloc(ctx_len * d_model, sizeof(float));
-  lung->Wo = (float*)calloc(d_model * vocab_size, sizeof(float));
+static void lung_wo_all(LungWeights* w) {
+  if (w->wo_complete) return;
+  for (int j = 0; j < w->vocab_size; j++) lung_wo_col(w, j);
+  w->wo_complete = 1;
+}
 
-  lung->Wq = (float*)calloc(n_heads * head_weight_size, sizeof(float));
-  lung->Wk = (float*)calloc(n_heads * head_weight_size, sizeof(float));
-  lung->Wv = (float*)calloc(n_heads * head_weight_size, sizeof(float));
+// ─────────────────────────────────────────────────────────────────────────────
+// WEIGHTS — shared, refcounted
+// ─────────────────────────────────────────────────────────────────────────────
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Notorch arrays
-  // ─────────────────────────────────────────────────────────────────────────────
-  lung->resonance = (float*)malloc(vocab_size * sizeof(float));
-  lung->presence_accum = (float*)calloc(vocab_size, sizeof(float));
+static void lung_weights_free(LungWeights* w) {
+  if (!w) return;
+  if (w->mips) {
+    free(w->mips->arena);
+    free(w->mips);
+  }
+  free(w->vocab_arena);
+  free(w->arena);
+  free(w);
+}
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Inference state
-  // ─────────────────────────────────────────────────────────────────────────────
-  lung->last_logits = (float*)calloc(vocab_size, sizeof(float));
-  lung->last_probs = (float*)calloc(vocab_size, sizeof(float));
-  lung->last_attention = (float*)calloc(ctx_len, sizeof(float));
+static LungWeights* lung_weights_new(int vocab_size, int d_model, int ctx_len, int n_heads, int n_kv_heads,
+                                     int lazy) {
+  if (!lung_dims_valid(vocab_size, d_model, ctx_len, n_heads)) return NULL;
+  if (!lung_kv_heads_valid(n_heads, n_kv_heads)) return NULL;
+
+  LungWeights* w = (LungWeights*)calloc(1, sizeof(LungWeights));
+  if (!w) return NULL;
+
+  // Store dimensions
+  w->refcount = 1;
+  w->vocab_size = vocab_size;
+  w->vocab_cap = vocab_size;
+  w->lazy = lazy;
+  w->d_model = d_model;
+  w->ctx_len = ctx_len;
+  w->n_heads = n_heads;
+  w->n_kv_heads = n_kv_heads;
+  w->head_dim = d_model / n_heads;
+  w->kv_dim = n_kv_heads * w->head_dim;
+
+  int head_weight_size = w->head_dim * d_model;
 
   // ─────────────────────────────────────────────────────────────────────────────
-  // Work buffers
+  // Allocate weights (a fixed block and a vocab block)
   // ─────────────────────────────────────────────────────────────────────────────
-  lung->X = (float*)calloc(ctx_len * d_model, sizeof(float));
-  lung->scores = (float*)calloc(ctx_len, sizeof(float));
-  lung->head_out = (float*)calloc(lung->head_dim, sizeof(float));
-  lung->y = (float*)calloc(d_model, sizeof(float));
-
-  // Check all allocations
-  if (!lung->E || !lung->P_ltr || !lung->P_rtl || !lung->Wo ||
-      !lung->Wq || !lung->Wk || !lung->Wv ||
-      !lung->resonance || !lung->presence_accum ||
-      !lung->last_logits || !lung->last_probs || !lung->last_attention ||
-      !lung->X || !lung->scores || !lung->head_out || !lung->y) {
-    // Allocation failed - clean up and return NULL
-    // (in production, would call lung_destroy here)
+  LungArena a = {NULL, 0};
+  lung_weights_layout(w, &a);
+  a.base = lung_arena_alloc(a.used, &w->arena);
+  if (!a.base) {
+    lung_weights_free(w);
     return NULL;
   }
+  a.used = 0;
+  lung_weights_layout(w, &a);
+
+  LungArena v = {NULL, 0};
+  lung_weights_vocab_layout(w, &v);
+  v.base = lung_arena_alloc(v.used, &w->vocab_arena);
+  if (!v.base) {
+    lung_weights_free(w);
+    return NULL;
+  }
+  v.used = 0;
+  lung_weights_vocab_layout(w, &v);
 
   // ─────────────────────────────────────────────────────────────────────────────
-  // Initialize weights
+  // Initialize weights (the global seed picks the stream; each create
+  // advances it so consecutive lungs differ)
   // ─────────────────────────────────────────────────────────────────────────────
-  init_random_weights(lung->E, vocab_size * d_model, INIT_SCALE);
-  init_random_weights(lung->Wo, d_model * vocab_size, INIT_SCALE);
+  _randf();
+  w->seed = _rand_state;
 
   for (int h = 0; h < n_heads; h++) {
-    init_random_weights(lung->Wq + h * head_weight_size, head_weight_size, INIT_SCALE);
-    init_random_weights(lung->Wk + h * head_weight_size, head_weight_size, INIT_SCALE);
-    init_random_weights(lung->Wv + h * head_weight_size, head_weight_size, INIT_SCALE);
+    uint32_t base = (uint32_t)(h * head_weight_size);
+    init_random_weights(w->Wq + h * head_weight_size, head_weight_size, w->seed, LUNG_STREAM_WQ, base, INIT_SCALE);
+  }
+  for (int h = 0; h < n_kv_heads; h++) {
+    uint32_t base = (uint32_t)(h * head_weight_size);
+    init_random_weights(w->Wk + h * head_weight_size, head_weight_size, w->seed, LUNG_STREAM_WK, base, INIT_SCALE);
+    init_random_weights(w->Wv + h * head_weight_size, head_weight_size, w->seed, LUNG_STREAM_WV, base, INIT_SCALE);
+  }
+
+  if (!lazy) {
+    lung_e_all(w);
+    lung_wo_all(w);
   }
 
   // Build positional encodings (both directions for PITOMADOM)
-  build_positional_encoding(lung->P_ltr, ctx_len, d_model, 0);  // LTR
-  build_positional_encoding(lung->P_rtl, ctx_len, d_model, 1);  // RTL
+  build_positional_encoding(w->P_ltr, ctx_len, d_model, 0);  // LTR
+  build_positional_encoding(w->P_rtl, ctx_len, d_model, 1);  // RTL
+
+  // Project positions once: K/V of a slot = token half + position half
+  int kvd = w->kv_dim;
+  for (int t = 0; t < ctx_len; t++) {
+    mat_vec(w->KP_ltr + t * kvd, w->Wk, w->P_ltr + t * d_model, kvd, d_model);
+    mat_vec(w->KP_rtl + t * kvd, w->Wk, w->P_rtl + t * d_model, kvd, d_model);
+    mat_vec(w->VP_ltr + t * kvd, w->Wv, w->P_ltr + t * d_model, kvd, d_model);
+    mat_vec(w->VP_rtl + t * kvd, w->Wv, w->P_rtl + t * d_model, kvd, d_model);
+  }
+  build_rotary_tables(w->rope_cos, w->rope_sin, ctx_len, w->head_dim);
+
+  return w;
+}
+
+EXPORT LungWeights* lung_weights_create(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  return lung_weights_new(vocab_size, d_model, ctx_len, n_heads, n_heads, 0);
+}
+
+// Grouped-query attention: n_heads query heads share n_kv_heads K/V
+// projections (n_heads a multiple of n_kv_heads; 1 = multi-query). K/V
+// projection FLOPs, Wk/Wv and every cached K/V row shrink by
+// n_heads / n_kv_heads. n_kv_heads == n_heads is lung_weights_create().
+EXPORT LungWeights* lung_weights_create_ex(int vocab_size, int d_model, int ctx_len, int n_heads, int n_kv_heads) {
+  return lung_weights_new(vocab_size, d_model, ctx_len, n_heads, n_kv_heads, 0);
+}
+
+// Same weights as lung_weights_create() with the same seed, but E rows and
+// Wo columns are generated on first touch: creation is O(heads · d²)
+// instead of O(vocab · d).
+EXPORT LungWeights* lung_weights_create_lazy(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  return lung_weights_new(vocab_size, d_model, ctx_len, n_heads, n_heads, 1);
+}
+
+// Generate every row now (before sharing lazy weights across threads, or
+// before handing E / Wo to code that reads them directly)
+EXPORT void lung_weights_materialize(LungWeights* w) {
+  if (!w) return;
+  lung_e_all(w);
+  lung_wo_all(w);
+}
+
+EXPORT LungWeights* lung_weights_retain(LungWeights* w) {
+  if (w) w->refcount++;
+  return w;
+}
+
+EXPORT void lung_weights_release(LungWeights* w) {
+  if (!w) return;
+  if (--w->refcount <= 0) lung_weights_free(w);
+}
+
+EXPORT int lung_weights_refcount(LungWeights* w) {
+  return w ? w->refcount : 0;
+}
+
+// Call after editing weights in place (e.g. through lung_get_embeddings):
+// sessions drop their cached token projections on the next forward.
+EXPORT void lung_weights_touch(LungWeights* w) {
+  if (w) w->version++;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// SESSIONS — per-field state over shared weights
+// ─────────────────────────────────────────────────────────────────────────────
+
+static void lung_pipeline_free(LungPipeline* p);
+
+static void lung_session_free(LungSession* lung) {
+  if (!lung) return;
+  lung_pipeline_free(lung->pipe);
+  free(lung->vocab_arena);
+  free(lung->arena);
+  free(lung);
+}
+
+// Create a session over existing weights (takes its own reference)
+EXPORT AriannaLung* lung_session_create(LungWeights* w) {
+  if (!w) return NULL;
+
+  LungSession* lung = (LungSession*)calloc(1, sizeof(LungSession));
+  if (!lung) return NULL;
+
+  lung->vocab_size = w->vocab_size;
+  lung->vocab_cap = w->vocab_size;
+  lung->d_model = w->d_model;
+  lung->ctx_len = w->ctx_len;
+  lung->n_heads = w->n_heads;
+  lung->n_kv_heads = w->n_kv_heads;
+  lung->head_dim = w->head_dim;
+  lung->kv_dim = w->kv_dim;
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Allocate notorch arrays, inference state and work buffers
+  // (a fixed block and a vocab block)
+  // ─────────────────────────────────────────────────────────────────────────────
+  LungArena a = {NULL, 0};
+  lung_session_layout(lung, &a);
+  a.base = lung_arena_alloc(a.used, &lung->arena);
+  if (!a.base) {
+    lung_session_free(lung);
+    return NULL;
+  }
+  a.used = 0;
+  lung_session_layout(lung, &a);
+
+  LungArena v = {NULL, 0};
+  lung_session_vocab_layout(lung, &v);
+  v.base = lung_arena_alloc(v.used, &lung->vocab_arena);
+  if (!v.base) {
+    lung_session_free(lung);
+    return NULL;
+  }
+  v.used = 0;
+  lung_session_vocab_layout(lung, &v);
 
   // Initialize resonance: 0.5 + random * 0.5
-  for (int i = 0; i < vocab_size; i++) {
+  for (int i = 0; i < lung->vocab_size; i++) {
     lung->resonance[i] = 0.5f + _randf() * 0.5f;
   }
 
+  lung_pick_kernels(lung);
+
+  // Empty K/V cache
+  for (int t = 0; t < lung->ctx_len; t++) lung->kv_tok[t] = -1;
+  lung->kv_version = w->version;
+
+  // Sampling stream derives from the global seed (xorshift must not be 0)
+  lung->sample_state = _rand_state ? _rand_state : 0xA17A11u;
+
   // ─────────────────────────────────────────────────────────────────────────────
   // Default parameters
   // ─────────────────────────────────────────────────────────────────────────────
@@ -316,32 +1043,106 @@ EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_
   lung->attend_focus = 0.70f;
   lung->attend_spread = 0.20f;
   lung->use_rtl = 0;
+  lung->use_rotary = 0;
   lung->temporal_alpha = 0.5f;  // symmetric by default
 
+  lung->w = lung_weights_retain(w);
+  return lung;
+}
+
+// Single-tenant convenience: private weights + one session over them
+EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  LungWeights* w = lung_weights_create(vocab_size, d_model, ctx_len, n_heads);
+  if (!w) return NULL;
+
+  AriannaLung* lung = lung_session_create(w);
+  lung_weights_release(w);  // session holds the only reference now
+  return lung;
+}
+
+// lung_create with grouped-query attention (see lung_weights_create_ex)
+EXPORT AriannaLung* lung_create_ex(int vocab_size, int d_model, int ctx_len, int n_heads, int n_kv_heads) {
+  LungWeights* w = lung_weights_create_ex(vocab_size, d_model, ctx_len, n_heads, n_kv_heads);
+  if (!w) return NULL;
+
+  AriannaLung* lung = lung_session_create(w);
+  lung_weights_release(w);
   return lung;
 }
 
 EXPORT void lung_destroy(AriannaLung* lung) {
   if (!lung) return;
+  LungWeights* w = lung->w;
+  lung_session_free(lung);
+  lung_weights_release(w);
+}
 
-  free(lung->E);
-  free(lung->P_ltr);
-  free(lung->P_rtl);
-  free(lung->Wo);
-  free(lung->Wq);
-  free(lung->Wk);
-  free(lung->Wv);
-  free(lung->resonance);
-  free(lung->presence_accum);
-  free(lung->last_logits);
-  free(lung->last_probs);
-  free(lung->last_attention);
-  free(lung->X);
-  free(lung->scores);
-  free(lung->head_out);
-  free(lung->y);
+EXPORT LungWeights* lung_get_weights(AriannaLung* lung) {
+  return lung ? lung->w : NULL;
+}
 
-  free(lung);
+EXPORT void lung_touch(AriannaLung* lung) {
+  if (lung) lung_weights_touch(lung->w);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// TOKEN K/V CACHE — incremental context handling
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// K and V of slot t are Wk·(E[tok] + P[t]) = Wk·E[tok] + KP[t]. The position
+// half lives in the weights; the token half depends on the token alone, so it
+// survives any shift of the window. Each forward:
+//   1. detects how far the window slid since the last breath (s slots)
+//   2. shifts the cached rows left by s
+//   3. projects only the slots whose token changed
+// A frame that pushes one token costs one row of K/V instead of ctx_len rows.
+// In rotary mode there is no position half at all: the cached rows are the
+// whole K/V, and the position enters only as a rotation at scoring time.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Returns the number of slots projected
+static int lung_sync_kv(LungSession* lung) {
+  LungWeights* w = lung->w;
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int kvd = lung->kv_dim;
+  const int* tok = lung->slot_tok;
+
+  if (lung->kv_version != w->version) {
+    for (int t = 0; t < ctx; t++) lung->kv_tok[t] = -1;
+    lung->kv_version = w->version;
+  }
+
+  // Find the smallest slide s with old[s + i] == new[i] over the overlap
+  int shift = 0;
+  for (int s = 0; s < ctx; s++) {
+    int match = 1;
+    for (int i = 0; i + s < ctx; i++) {
+      if (lung->kv_tok[i + s] != tok[i]) { match = 0; break; }
+    }
+    if (match) { shift = s; break; }
+  }
+
+  if (shift > 0) {
+    int keep = ctx - shift;
+    memmove(lung->kv_tok, lung->kv_tok + shift, keep * sizeof(int));
+    memmove(lung->KE, lung->KE + shift * kvd, (size_t)keep * kvd * sizeof(float));
+    memmove(lung->VE, lung->VE + shift * kvd, (size_t)keep * kvd * sizeof(float));
+    for (int t = keep; t < ctx; t++) lung->kv_tok[t] = -1;
+  }
+
+  // Project the slots that are new (or never matched)
+  int projected = 0;
+  for (int t = 0; t < ctx; t++) {
+    if (lung->kv_tok[t] == tok[t]) continue;
+    const float* e = lung_e_row(w, tok[t]);
+    mat_vec(lung->KE + t * kvd, w->Wk, e, kvd, d);
+    mat_vec(lung->VE + t * kvd, w->Wv, e, kvd, d);
+    lung->kv_tok[t] = tok[t];
+    projected++;
+  }
+  return projected;
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -359,72 +1160,65 @@ EXPORT void lung_destroy(AriannaLung* lung) {
 //
 // ═══════════════════════════════════════════════════════════════════════════════
 
-EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len) {
-  if (!lung || !context) return 0.0f;
-
+// Attention core shared by lung_forward and the beam engine. Reads the slot
+// K/V through lung->k_rows / v_rows (token half) plus the positional half,
+// the per-slot resonance multiplier from lung->slot_res, and writes the raw
+// logits (before presence) for a query at the last slot holding last_tok.
+// Touches only work buffers; attn_out (ctx_len) and logits may be NULL —
+// lung->y always holds the hidden state.
+static void lung_attend(LungSession* lung, int last_tok, float* attn_out, float* logits) {
+  LungWeights* w = lung->w;
   int ctx = lung->ctx_len;
   int d = lung->d_model;
   int vocab = lung->vocab_size;
   int n_heads = lung->n_heads;
   int head_dim = lung->head_dim;
-  int head_weight_size = head_dim * d;
+  int qkv = n_heads * head_dim;
+  int group = n_heads / lung->n_kv_heads;  // query heads per K/V head
 
   // Select positional encoding based on RTL mode
-  float* P = lung->use_rtl ? lung->P_rtl : lung->P_ltr;
+  const float* P = lung->use_rtl ? w->P_rtl : w->P_ltr;
+  int rotary = lung->use_rotary;
 
   // ─────────────────────────────────────────────────────────────────────────────
-  // Build token vectors: X[t] = E[token[t]] + P[t]
+  // Multi-head attention (NO CAUSAL MASK — bidirectional!)
   // ─────────────────────────────────────────────────────────────────────────────
-  memset(lung->X, 0, ctx * d * sizeof(float));
-
-  for (int t = 0; t < ctx; t++) {
-    int token_id = (t < context_len) ? context[t] : 0;  // pad with 0
-    if (token_id < 0) token_id = 0;
-    if (token_id >= vocab) token_id = vocab - 1;
+  if (attn_out) memset(attn_out, 0, ctx * sizeof(float));
+  memset(lung->y, 0, d * sizeof(float));
 
+  int last_pos = ctx - 1;
+  float temporal_bias = (lung->temporal_alpha - 0.5f) * 2.0f;  // [-1, 1]
+  LUNG_PROF_START();
+
+  // Queries from last token: X[last] = E[token] + P[last] (rotary: E only)
+  const float* e_last = lung_e_row(w, last_tok);
+  if (rotary) {
+    mat_vec(lung->q, w->Wq, e_last, qkv, d);
+  } else {
+    const float* p_last = P + last_pos * d;
     for (int i = 0; i < d; i++) {
-      lung->X[t * d + i] = lung->E[token_id * d + i] + P[t * d + i];
+      lung->x_last[i] = e_last[i] + p_last[i];
     }
+    mat_vec(lung->q, w->Wq, lung->x_last, qkv, d);
   }
+  LUNG_PROF_LAP(lung, LUNG_PHASE_EMBED, sizeof(float) * ((size_t)qkv * d + 2 * d + qkv));
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Multi-head attention (NO CAUSAL MASK — bidirectional!)
-  // ─────────────────────────────────────────────────────────────────────────────
-  memset(lung->last_attention, 0, ctx * sizeof(float));
-  memset(lung->y, 0, d * sizeof(float));
-
-  float* q = lung->head_out;  // reuse buffer for query
-  float* k = (float*)alloca(head_dim * sizeof(float));  // stack allocate key
-  float* v = (float*)alloca(head_dim * sizeof(float));  // stack allocate value
-  float* head_result = (float*)alloca(head_dim * sizeof(float));
-
-  int last_pos = ctx - 1;
-  float sqrt_head_dim = sqrtf((float)head_dim);
-  float temporal_bias = (lung->temporal_alpha - 0.5f) * 2.0f;  // [-1, 1]
+  float* head_result = lung->head_out;
 
   for (int h = 0; h < n_heads; h++) {
-    float* Wq_h = lung->Wq + h * head_weight_size;
-    float* Wk_h = lung->Wk + h * head_weight_size;
-    float* Wv_h = lung->Wv + h * head_weight_size;
+    const float* q = lung->q + h * head_dim;
+    int hoff = h * head_dim;
+    int kvoff = (h / group) * head_dim;  // shared K/V head of this query head
 
-    // Query from last token
-    float* x_last = lung->X + last_pos * d;
-    mat_vec(q, Wq_h, x_last, head_dim, d);
+    // Base scores q·k / sqrt(head_dim) for all positions (head kernel)
+    lung->score_kernel(lung, q, kvoff, lung->scores);
+    LUNG_PROF_LAP(lung, LUNG_PHASE_QK, sizeof(float) * (size_t)ctx * (2 * head_dim + 1));
 
-    // Compute attention scores for all positions
     for (int t = 0; t < ctx; t++) {
-      float* x_t = lung->X + t * d;
-      mat_vec(k, Wk_h, x_t, head_dim, d);
-
-      // Base score: q·k / sqrt(head_dim)
-      float score = dot(q, k, head_dim) / sqrt_head_dim;
+      float score = lung->scores[t];
 
       // Apply resonance modulation
-      int token_id = (t < context_len) ? context[t] : 0;
-      if (token_id >= 0 && token_id < vocab) {
-        float res_boost = lung->resonance[token_id] * RESONANCE_ATTENTION_COUPLING;
-        score *= (1.0f + res_boost);
-      }
+      score *= lung->slot_res[t];
 
       // ═══════════════════════════════════════════════════════════════════════
       // PITOMADOM TEMPORAL SYMMETRY
@@ -461,43 +1255,73 @@ EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len
     softmax(lung->scores, ctx);
 
     // Accumulate combined attention (for visualization)
-    float head_weight = 1.0f / (float)n_heads;
-    for (int t = 0; t < ctx; t++) {
-      lung->last_attention[t] += lung->scores[t] * head_weight;
+    if (attn_out) {
+      float head_weight = 1.0f / (float)n_heads;
+      for (int t = 0; t < ctx; t++) {
+        attn_out[t] += lung->scores[t] * head_weight;
+      }
     }
+    LUNG_PROF_LAP(lung, LUNG_PHASE_SOFTMAX, sizeof(float) * (size_t)ctx * 3);
 
-    // Weighted sum of values
-    memset(head_result, 0, head_dim * sizeof(float));
-    for (int t = 0; t < ctx; t++) {
-      float* x_t = lung->X + t * d;
-      mat_vec(v, Wv_h, x_t, head_dim, d);
-      axpy(head_result, v, lung->scores[t], head_dim);
-    }
+    // Weighted sum of values (token half + position half; rotary: token only)
+    lung->value_kernel(lung, lung->scores, kvoff, head_result);
 
     // Concatenate into y
-    int offset = h * head_dim;
-    for (int i = 0; i < head_dim && offset + i < d; i++) {
-      lung->y[offset + i] = head_result[i];
+    for (int i = 0; i < head_dim && hoff + i < d; i++) {
+      lung->y[hoff + i] = head_result[i];
     }
+    LUNG_PROF_LAP(lung, LUNG_PHASE_VALUE, sizeof(float) * ((size_t)ctx * (2 * head_dim + 1) + 2 * head_dim));
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
   // Output projection: logits = Wo^T · y
   // ─────────────────────────────────────────────────────────────────────────────
-  mat_vec_t(lung->last_logits, lung->Wo, lung->y, d, vocab);
+  if (logits) {
+    lung_wo_all(w);
+    mat_vec_t(logits, w->Wo, lung->y, d, vocab, w->vocab_cap);
+    LUNG_PROF_LAP(lung, LUNG_PHASE_PROJECTION, sizeof(float) * ((size_t)d * vocab + d + vocab));
+  }
+}
 
-  // Apply presence pulse modulation
-  for (int i = 0; i < vocab; i++) {
-    lung->last_logits[i] *= (1.0f + lung->presence_accum[i] * PRESENCE_LOGIT_COUPLING);
+// Resonance multiplier of a slot holding the raw (unclamped) token
+static float lung_slot_resonance(const LungSession* lung, int token_id) {
+  if (token_id < 0 || token_id >= lung->vocab_size) return 1.0f;
+  return 1.0f + lung->resonance[token_id] * RESONANCE_ATTENTION_COUPLING;
+}
+
+// Resolve slot tokens, bring the token K/V cache up to date and point the
+// slot rows at it
+static void lung_load_context(LungSession* lung, const int* context, int context_len) {
+  int ctx = lung->ctx_len;
+  int vocab = lung->vocab_size;
+  int kvd = lung->kv_dim;
+  LUNG_PROF_START();
+
+  for (int t = 0; t < ctx; t++) {
+    int raw = (t < context_len) ? context[t] : 0;  // pad with 0
+    int token_id = raw;
+    if (token_id < 0) token_id = 0;
+    if (token_id >= vocab) token_id = vocab - 1;
+    lung->slot_tok[t] = token_id;
+    lung->slot_res[t] = lung_slot_resonance(lung, raw);
   }
+  int projected = lung_sync_kv(lung);
 
-  // Compute probabilities
-  memcpy(lung->last_probs, lung->last_logits, vocab * sizeof(float));
-  softmax(lung->last_probs, vocab);
+  for (int t = 0; t < ctx; t++) {
+    lung->k_rows[t] = lung->KE + t * kvd;
+    lung->v_rows[t] = lung->VE + t * kvd;
+  }
+  (void)projected;
+  LUNG_PROF_LAP(lung, LUNG_PHASE_EMBED,
+                sizeof(float) * (size_t)projected * (2 * (size_t)kvd * lung->d_model + lung->d_model + 2 * kvd) +
+                (size_t)ctx * (3 * sizeof(int) + 2 * sizeof(float) + 2 * sizeof(float*)));
+}
+
+// Every breath decays presence and pulses the tokens it saw
+static void lung_update_presence(LungSession* lung, const int* context, int context_len) {
+  int ctx = lung->ctx_len;
+  int vocab = lung->vocab_size;
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Update presence accumulator
-  // ─────────────────────────────────────────────────────────────────────────────
   for (int i = 0; i < vocab; i++) {
     lung->presence_accum[i] *= lung->presence_decay;
   }
@@ -508,6 +1332,35 @@ EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len
       lung->presence_accum[token_id] = (new_val > 1.0f) ? 1.0f : new_val;
     }
   }
+}
+
+EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len) {
+  if (!lung || !context) return 0.0f;
+
+  int ctx = lung->ctx_len;
+  int vocab = lung->vocab_size;
+
+  lung_load_context(lung, context, context_len);
+  lung_attend(lung, lung->slot_tok[ctx - 1], lung->last_attention, lung->last_logits);
+  memcpy(lung->last_hidden, lung->y, lung->d_model * sizeof(float));
+  LUNG_PROF_START();
+
+  // Apply presence pulse modulation
+  for (int i = 0; i < vocab; i++) {
+    lung->last_logits[i] *= (1.0f + lung->presence_accum[i] * PRESENCE_LOGIT_COUPLING);
+  }
+  LUNG_PROF_LAP(lung, LUNG_PHASE_MODULATION, sizeof(float) * (size_t)vocab * 3);
+
+  // Compute probabilities
+  memcpy(lung->last_probs, lung->last_logits, vocab * sizeof(float));
+  softmax(lung->last_probs, vocab);
+  LUNG_PROF_LAP(lung, LUNG_PHASE_SOFTMAX, sizeof(float) * (size_t)vocab * 5);
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Update presence accumulator
+  // ─────────────────────────────────────────────────────────────────────────────
+  lung_update_presence(lung, context, context_len);
+  LUNG_PROF_LAP(lung, LUNG_PHASE_MODULATION, sizeof(float) * (size_t)vocab * 2 + sizeof(int) * (size_t)ctx);
 
   // ─────────────────────────────────────────────────────────────────────────────
   // Compute entropy (return value)
@@ -519,10 +1372,27 @@ EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len
       entropy -= p * logf(p);
     }
   }
+  LUNG_PROF_LAP(lung, LUNG_PHASE_ENTROPY, sizeof(float) * (size_t)vocab);
 
   return entropy;
 }
 
+// A breath without the output projection: attention, hidden state and
+// presence update exactly as lung_forward, but last_logits / last_probs are
+// left stale. Pair with lung_top_k_approx() when only the top few tokens
+// matter — the O(vocab · d) projection is what it skips.
+EXPORT void lung_forward_hidden(AriannaLung* lung, const int* context, int context_len) {
+  if (!lung || !context) return;
+
+  lung_load_context(lung, context, context_len);
+  lung_attend(lung, lung->slot_tok[lung->ctx_len - 1], lung->last_attention, NULL);
+  memcpy(lung->last_hidden, lung->y, lung->d_model * sizeof(float));
+  LUNG_PROF_START();
+  lung_update_presence(lung, context, context_len);
+  LUNG_PROF_LAP(lung, LUNG_PHASE_MODULATION, sizeof(float) * (size_t)lung->vocab_size * 2 + sizeof(int) * (size_t)lung->ctx_len);
+}
+
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // GETTERS — expose inference state to JS
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -566,8 +1436,10 @@ EXPORT int lung_get_top_k(AriannaLung* lung, int* out_indices, int k) {
   if (!lung || !lung->last_logits || !out_indices || k <= 0) return 0;
   if (k > lung->vocab_size) k = lung->vocab_size;
 
-  // Simple O(k*n) selection (fine for small k)
-  float* used = (float*)alloca(lung->vocab_size * sizeof(float));
+  LUNG_PROF_START();
+
+  // Simple O(k*n) selection (fine for small k), on a session scratch copy
+  float* used = lung->rank_val;
   memcpy(used, lung->last_logits, lung->vocab_size * sizeof(float));
 
   for (int i = 0; i < k; i++) {
@@ -584,10 +1456,950 @@ EXPORT int lung_get_top_k(AriannaLung* lung, int* out_indices, int k) {
     out_indices[i] = max_idx;
     used[max_idx] = -1e30f;  // mark as used
   }
+  LUNG_PROF_LAP(lung, LUNG_PHASE_TOPK, sizeof(float) * (size_t)lung->vocab_size * (k + 2));
 
   return k;
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+// CANDIDATE SCORING — logits for a handful of tokens
+// ─────────────────────────────────────────────────────────────────────────────
+//
+// Callers that need p(token) for a few tokens (surprisal, LoRA targets) pay
+// O(m · d) for the output projection instead of O(vocab · d). Same attention
+// and presence modulation as lung_forward, but nothing breathes: presence and
+// last_* are untouched.
+//
+// The return value is the log-normalizer log Σ exp(logit), chosen by
+// norm_budget:
+//   <= 0   not computed (returns 0) — compare candidates among themselves
+//   >= 1   exact (full projection)
+//   else   estimated: candidates exactly + a stride sample of norm_budget·vocab
+//          other tokens scaled up to the rest of the vocab
+// p(cand_ids[i]) = exp(out_logits[i] - log_norm). Invalid ids get -1e30.
+//
+// ─────────────────────────────────────────────────────────────────────────────
+
+static float lung_column_logit(const LungSession* lung, int token_id) {
+  lung_wo_col(lung->w, token_id);
+  const float* Wo = lung->w->Wo;
+  size_t stride = (size_t)lung->w->vocab_cap;
+  float sum = 0.0f;
+  for (int i = 0; i < lung->d_model; i++) {
+    sum += Wo[i * stride + token_id] * lung->y[i];
+  }
+  return sum * (1.0f + lung->presence_accum[token_id] * PRESENCE_LOGIT_COUPLING);
+}
+
+EXPORT float lung_forward_candidates(AriannaLung* lung, const int* context, int context_len,
+                                     const int* cand_ids, int m, float* out_logits, float norm_budget) {
+  if (!lung || !context || !cand_ids || !out_logits || m <= 0) return 0.0f;
+
+  int vocab = lung->vocab_size;
+  lung_load_context(lung, context, context_len);
+  lung_attend(lung, lung->slot_tok[lung->ctx_len - 1], NULL, NULL);
+
+  if (norm_budget >= 1.0f) {
+    // Exact: the full projection anyway, candidates read from it
+    float* logits = lung->rank_val;
+    lung_wo_all(lung->w);
+    mat_vec_t(logits, lung->w->Wo, lung->y, lung->d_model, vocab, lung->w->vocab_cap);
+    float max_val = -1e30f;
+    for (int i = 0; i < vocab; i++) {
+      logits[i] *= (1.0f + lung->presence_accum[i] * PRESENCE_LOGIT_COUPLING);
+      if (logits[i] > max_val) max_val = logits[i];
+    }
+    float sum = 0.0f;
+    for (int i = 0; i < vocab; i++) sum += expf(logits[i] - max_val);
+    for (int i = 0; i < m; i++) {
+      int tok = cand_ids[i];
+      out_logits[i] = (tok >= 0 && tok < vocab) ? logits[tok] : -1e30f;
+    }
+    return max_val + logf(sum);
+  }
+
+  float max_val = -1e30f;
+  for (int i = 0; i < m; i++) {
+    int tok = cand_ids[i];
+    out_logits[i] = (tok >= 0 && tok < vocab) ? lung_column_logit(lung, tok) : -1e30f;
+    if (out_logits[i] > max_val) max_val = out_logits[i];
+  }
+  if (norm_budget <= 0.0f) return 0.0f;
+
+  // Estimate: unique candidates exactly, the rest from a stride sample.
+  // rank_val marks candidates (1 = seen, 2 = summed once).
+  float* mark = lung->rank_val;
+  memset(mark, 0, vocab * sizeof(float));
+  int n_unique = 0;
+  for (int i = 0; i < m; i++) {
+    int tok = cand_ids[i];
+    if (tok < 0 || tok >= vocab || mark[tok] != 0.0f) continue;
+    mark[tok] = 1.0f;
+    n_unique++;
+  }
+
+  float cand_sum = 0.0f, rest_sum = 0.0f;
+  for (int i = 0; i < m; i++) {
+    int tok = cand_ids[i];
+    if (tok < 0 || tok >= vocab || mark[tok] != 1.0f) continue;
+    mark[tok] = 2.0f;
+    cand_sum += expf(out_logits[i] - max_val);
+  }
+
+  // Running max: rescale both sums when a sample beats it
+  int n_samples = (int)(norm_budget * (float)vocab);
+  if (n_samples < 1) n_samples = 1;
+  int n_rest = 0;
+  for (int s = 0; s < n_samples; s++) {
+    int tok = (int)(((long long)s * vocab) / n_samples);
+    if (mark[tok] != 0.0f) continue;
+    float logit = lung_column_logit(lung, tok);
+    if (logit > max_val) {
+      float rescale = expf(max_val - logit);
+      cand_sum *= rescale;
+      rest_sum *= rescale;
+      max_val = logit;
+    }
+    rest_sum += expf(logit - max_val);
+    n_rest++;
+  }
+
+  float others = (float)(vocab - n_unique);
+  float scale = (n_rest > 0) ? others / (float)n_rest : 0.0f;
+  return max_val + logf(cand_sum + scale * rest_sum);
+}
+
+
+// ─────────────────────────────────────────────────────────────────────────────
+// PROFILE ACCESS — counters accumulated since the last reset
+// ─────────────────────────────────────────────────────────────────────────────
+//
+// out[3·phase + 0] = nanoseconds, [+1] = bytes touched (estimate),
+// [+2] = calls, phases in LUNG_PHASE_* order (EMBED, QK, SOFTMAX, VALUE,
+// PROJECTION, MODULATION, ENTROPY, TOPK). QK / SOFTMAX / VALUE count once
+// per head. Returns the number of doubles written: at most
+// 3 · LUNG_PROFILE_PHASES, and 0 when built without -DLUNG_PROFILE.
+
+EXPORT int lung_get_profile(AriannaLung* lung, double* out, int n) {
+#ifdef LUNG_PROFILE
+  if (!lung || !out || n <= 0) return 0;
+  if (n > LUNG_PROFILE_PHASES * 3) n = LUNG_PROFILE_PHASES * 3;
+  memcpy(out, lung->profile, n * sizeof(double));
+  return n;
+#else
+  (void)lung;
+  (void)out;
+  (void)n;
+  return 0;
+#endif
+}
+
+EXPORT void lung_profile_reset(AriannaLung* lung) {
+#ifdef LUNG_PROFILE
+  if (lung) memset(lung->profile, 0, sizeof(lung->profile));
+#else
+  (void)lung;
+#endif
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// APPROXIMATE TOP-K — inner-product index over the Wo columns
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// logit[j] = Wo[:, j] · hidden. The vocab columns are clustered (spherical
+// k-means, ~sqrt(vocab) clusters) and each cluster keeps its mean column c and
+// radius r = max ||col - c||. For a hidden state h no column in the cluster
+// can beat
+//     c·h + r·||h||           (Cauchy-Schwarz)
+// so clusters are scanned best bound first. The scan stops as soon as the
+// k-th best logit beats every remaining bound (exact), or when the recall
+// budget — the fraction of vocab to score — runs out (approximate).
+//
+// The index belongs to the weights (shared by all sessions), is built on
+// first use and rebuilt whenever the weights version moves (lung_touch).
+// Building writes the shared weights: sessions querying on other threads
+// (LUNG_THREADS) should lung_mips_prepare() first, and again after each
+// lung_touch. It keeps a packed copy of Wo, so it doubles the
+// output-projection memory.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LUNG_MIPS_ITERS   8   // k-means refinement passes at build time
+
+static void lung_mips_layout(LungMipsIndex* m, LungArena* a, int vocab, int d) {
+  size_t nc = (size_t)m->n_clusters;
+  m->centroids = arena_floats(a, nc * (size_t)d);
+  m->radius = arena_floats(a, nc);
+  m->offsets = arena_ints(a, nc + 1);
+  m->members = arena_ints(a, (size_t)vocab);
+  m->cols = arena_floats(a, (size_t)vocab * (size_t)d);
+}
+
+static void lung_normalize(float* v, int n) {
+  float norm = 0.0f;
+  for (int i = 0; i < n; i++) norm += v[i] * v[i];
+  norm = (norm > 1e-20f) ? 1.0f / sqrtf(norm) : 0.0f;
+  for (int i = 0; i < n; i++) v[i] *= norm;
+}
+
+static int lung_mips_build(LungWeights* w) {
+  int vocab = w->vocab_size;
+  int d = w->d_model;
+  int nc = lung_mips_clusters(vocab);
+
+  LungMipsIndex* m = w->mips;
+  if (!m) {
+    m = (LungMipsIndex*)calloc(1, sizeof(LungMipsIndex));
+    if (!m) return 0;
+    m->n_clusters = nc;
+    LungArena a = {NULL, 0};
+    lung_mips_layout(m, &a, vocab, d);
+    a.base = lung_arena_alloc(a.used, &m->arena);
+    if (!a.base) {
+      free(m);
+      return 0;
+    }
+    a.used = 0;
+    lung_mips_layout(m, &a, vocab, d);
+    w->mips = m;
+  }
+
+  lung_wo_all(w);
+
+  // Build-time scratch: unit direction of every column, its cluster, and a
+  // fill cursor per cluster
+  float* dir = (float*)malloc((size_t)vocab * d * sizeof(float));
+  int* assign = (int*)malloc((size_t)vocab * sizeof(int));
+  int* cursor = (int*)malloc((size_t)nc * sizeof(int));
+  if (!dir || !assign || !cursor) {
+    free(dir);
+    free(assign);
+    free(cursor);
+    return 0;
+  }
+  for (int j = 0; j < vocab; j++) {
+    for (int i = 0; i < d; i++) dir[j * d + i] = w->Wo[(size_t)i * w->vocab_cap + j];
+    lung_normalize(dir + j * d, d);
+  }
+
+  // Spherical k-means: evenly spaced seeds, assign by cosine, renormalize
+  for (int c = 0; c < nc; c++) {
+    memcpy(m->centroids + c * d, dir + (size_t)c * vocab / nc * d, d * sizeof(float));
+  }
+  for (int it = 0; it < LUNG_MIPS_ITERS; it++) {
+    for (int j = 0; j < vocab; j++) {
+      int best = 0;
+      float best_dot = -1e30f;
+      for (int c = 0; c < nc; c++) {
+        float v = dot(dir + j * d, m->centroids + c * d, d);
+        if (v > best_dot) { best_dot = v; best = c; }
+      }
+      assign[j] = best;
+    }
+    for (int c = 0; c < nc; c++) {
+      float* cen = m->centroids + c * d;
+      int count = 0;
+      for (int j = 0; j < vocab; j++) {
+        if (assign[j] != c) continue;
+        if (count++ == 0) memset(cen, 0, d * sizeof(float));
+        axpy(cen, dir + j * d, 1.0f, d);
+      }
+      if (count > 0) lung_normalize(cen, d);  // an empty cluster keeps its seed
+    }
+  }
+
+  // Group tokens by cluster (counting sort, token order within a cluster)
+  // and pack their raw columns contiguously
+  memset(m->offsets, 0, (nc + 1) * sizeof(int));
+  for (int j = 0; j < vocab; j++) m->offsets[assign[j] + 1]++;
+  for (int c = 0; c < nc; c++) m->offsets[c + 1] += m->offsets[c];
+  memcpy(cursor, m->offsets, nc * sizeof(int));
+  for (int j = 0; j < vocab; j++) {
+    int slot = cursor[assign[j]]++;
+    m->members[slot] = j;
+    for (int i = 0; i < d; i++) m->cols[slot * d + i] = w->Wo[(size_t)i * w->vocab_cap + j];
+  }
+
+  // Bounds: mean column and max distance to it
+  for (int c = 0; c < nc; c++) {
+    float* cen = m->centroids + c * d;
+    int begin = m->offsets[c], end = m->offsets[c + 1];
+    memset(cen, 0, d * sizeof(float));
+    for (int s = begin; s < end; s++) axpy(cen, m->cols + s * d, 1.0f, d);
+    if (end > begin) {
+      for (int i = 0; i < d; i++) cen[i] /= (float)(end - begin);
+    }
+    float r2 = 0.0f;
+    for (int s = begin; s < end; s++) {
+      float dist = 0.0f;
+      for (int i = 0; i < d; i++) {
+        float diff = m->cols[s * d + i] - cen[i];
+        dist += diff * diff;
+      }
+      if (dist > r2) r2 = dist;
+    }
+    m->radius[c] = sqrtf(r2);
+  }
+
+  free(dir);
+  free(assign);
+  free(cursor);
+  m->version = w->version;
+  return 1;
+}
+
+// Build (or rebuild after lung_touch) the index now instead of on the first
+// lung_top_k_approx. Returns 0 when allocation fails.
+EXPORT int lung_mips_prepare(LungWeights* w) {
+  if (!w) return 0;
+  if (w->mips && w->mips->version == w->version) return 1;
+  return lung_mips_build(w);
+}
+
+// Top-k tokens by presence-modulated logit of the last hidden state (set by
+// lung_forward or lung_forward_hidden), best first. recall_budget in (0, 1]
+// is the fraction of vocab the scan may score; >= 1 is exact. At least one
+// cluster is always scanned. Returns the number of indices written.
+EXPORT int lung_top_k_approx(AriannaLung* lung, int* out_indices, int k, float recall_budget) {
+  if (!lung || !out_indices || k <= 0) return 0;
+
+  LungWeights* w = lung->w;
+  int vocab = lung->vocab_size;
+  int d = lung->d_model;
+  if (k > vocab) k = vocab;
+
+  if (!w->mips || w->mips->version != w->version) {
+    if (!lung_mips_build(w)) return lung_get_top_k(lung, out_indices, k);
+  }
+  const LungMipsIndex* m = w->mips;
+  int nc = m->n_clusters;
+  const float* h = lung->last_hidden;
+  LUNG_PROF_START();
+
+  // Rank clusters by their upper bound
+  float h_norm = sqrtf(dot(h, h, d));
+  for (int c = 0; c < nc; c++) {
+    lung->cluster_ub[c] = dot(m->centroids + c * d, h, d) + m->radius[c] * h_norm;
+    int j = c;
+    while (j > 0 && lung->cluster_ub[lung->cluster_order[j - 1]] < lung->cluster_ub[c]) {
+      lung->cluster_order[j] = lung->cluster_order[j - 1];
+      j--;
+    }
+    lung->cluster_order[j] = c;
+  }
+
+  int budget = (recall_budget >= 1.0f) ? vocab : (int)(recall_budget * (float)vocab);
+  int scanned = 0;
+  int n_top = 0;
+  float* val = lung->rank_val;
+
+  for (int ci = 0; ci < nc; ci++) {
+    int c = lung->cluster_order[ci];
+
+    // Presence only amplifies (factor in [1, 1 + coupling]), so a positive
+    // bound may grow by the full coupling and a negative one cannot grow
+    float ub = lung->cluster_ub[c];
+    float bound = (ub > 0.0f) ? ub * (1.0f + PRESENCE_LOGIT_COUPLING) : ub;
+    if (n_top == k && val[k - 1] >= bound) break;   // provably exact
+    if (ci > 0 && scanned >= budget) break;         // budget spent
+
+    for (int s = m->offsets[c]; s < m->offsets[c + 1]; s++) {
+      int tok = m->members[s];
+      float logit = dot(m->cols + s * d, h, d) *
+                    (1.0f + lung->presence_accum[tok] * PRESENCE_LOGIT_COUPLING);
+      if (n_top == k && logit <= val[k - 1]) continue;
+
+      int j = (n_top < k) ? n_top++ : k - 1;
+      while (j > 0 && (val[j - 1] < logit || (val[j - 1] == logit && out_indices[j - 1] > tok))) {
+        val[j] = val[j - 1];
+        out_indices[j] = out_indices[j - 1];
+        j--;
+      }
+      val[j] = logit;
+      out_indices[j] = tok;
+    }
+    scanned += m->offsets[c + 1] - m->offsets[c];
+  }
+  LUNG_PROF_LAP(lung, LUNG_PHASE_TOPK,
+                sizeof(float) * (size_t)nc * (d + 2) + (size_t)scanned * (sizeof(float) * (d + 1) + sizeof(int)));
+
+  return n_top;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PROPHECY — multi-step rollouts without leaving C
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// lung_prophesy(): the lung breathes `steps` times, each time appending its own
+// prediction to a rolling window (oldest token falls off). Every step is a
+// full lung_forward — presence accumulates exactly as with repeated calls —
+// but the window shift only projects the one new token (see TOKEN K/V CACHE).
+//
+// lung_tunnel(): same rolling window, but the appended tokens are forced by
+// the caller (the field's tunneling skip). Per-step probabilities are copied
+// out so the field can manifest every step ahead.
+//
+// The window starts as the last ctx_len tokens of the context, left-padded
+// with 0 (same convention as the JS wrapper).
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LUNG_PROPHESY_GREEDY   0   // argmax each step (destiny)
+#define LUNG_PROPHESY_SAMPLE   1   // sample from probs each step (wormhole)
+
+static uint32_t lung_xorshift(uint32_t* s) {
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+static int lung_sample_token(LungSession* lung) {
+  float r = (lung_xorshift(&lung->sample_state) & 0xFFFFFF) / 16777216.0f;
+  float acc = 0.0f;
+  for (int i = 0; i < lung->vocab_size; i++) {
+    acc += lung->last_probs[i];
+    if (r < acc) return i;
+  }
+  return lung->vocab_size - 1;
+}
+
+static void lung_window_init(LungSession* lung, const int* context, int context_len) {
+  int ctx = lung->ctx_len;
+  int n = (context_len < ctx) ? context_len : ctx;
+  int pad = ctx - n;
+  for (int t = 0; t < pad; t++) lung->window[t] = 0;
+  for (int t = 0; t < n; t++) lung->window[pad + t] = context[context_len - n + t];
+}
+
+static void lung_window_push(LungSession* lung, int token_id) {
+  int ctx = lung->ctx_len;
+  memmove(lung->window, lung->window + 1, (ctx - 1) * sizeof(int));
+  lung->window[ctx - 1] = token_id;
+}
+
+EXPORT void lung_set_sample_seed(AriannaLung* lung, uint32_t seed) {
+  if (lung) lung->sample_state = seed ? seed : 0xA17A11u;
+}
+
+// out_tokens[steps], out_probs[steps] (prob of chosen token), out_entropy[steps]
+// (entropy of the full distribution). Any output may be NULL. Returns steps run.
+EXPORT int lung_prophesy(AriannaLung* lung, const int* context, int context_len, int steps, int mode,
+                         int* out_tokens, float* out_probs, float* out_entropy) {
+  if (!lung || !context || context_len < 0 || steps <= 0) return 0;
+
+  lung_window_init(lung, context, context_len);
+
+  for (int i = 0; i < steps; i++) {
+    float entropy = lung_forward(lung, lung->window, lung->ctx_len);
+    int token = (mode == LUNG_PROPHESY_SAMPLE) ? lung_sample_token(lung) : lung_get_argmax(lung);
+
+    if (out_tokens) out_tokens[i] = token;
+    if (out_probs) out_probs[i] = lung->last_probs[token];
+    if (out_entropy) out_entropy[i] = entropy;
+
+    lung_window_push(lung, token);
+  }
+
+  return steps;
+}
+
+// out_probs: n × vocab_size (may be NULL), out_entropy[n] (may be NULL)
+EXPORT int lung_tunnel(AriannaLung* lung, const int* context, int context_len, const int* forced, int n,
+                       float* out_probs, float* out_entropy) {
+  if (!lung || !context || !forced || context_len < 0 || n <= 0) return 0;
+
+  lung_window_init(lung, context, context_len);
+
+  for (int i = 0; i < n; i++) {
+    lung_window_push(lung, forced[i]);
+    float entropy = lung_forward(lung, lung->window, lung->ctx_len);
+
+    if (out_probs) memcpy(out_probs + (size_t)i * lung->vocab_size, lung->last_probs,
+                          lung->vocab_size * sizeof(float));
+    if (out_entropy) out_entropy[i] = entropy;
+  }
+
+  return n;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// BEAM — tree-structured prophecy
+// ─────────────────────────────────────────────────────────────────────────────
+//
+// lung_prophesy_beam() keeps the `width` most likely futures alive at every
+// step and returns the best n_out of them with cumulative log-probabilities.
+//
+// Branches share their prefix instead of recomputing it:
+//   - the starting window is projected once into the session K/V cache;
+//     a branch of depth k reads its older slots from rows k.. of that cache
+//   - every appended token is a node (token, parent) with its own Wk·E / Wv·E
+//     row, projected once when the node survives; children point at parents
+// A branch's window is therefore assembled from row pointers, and each
+// expansion costs one attention pass + one output projection — never a
+// re-projection of the context.
+//
+// Each branch carries its own presence pulse, evolved exactly as
+// lung_prophesy() would evolve it, so width 1 reproduces the greedy rollout.
+// The session itself does not breathe: presence and last_* are untouched.
+//
+// ─────────────────────────────────────────────────────────────────────────────
+
+typedef struct {
+  int* node_tok;       // steps × width: token of each node
+  int* node_parent;    // steps × width: parent node (-1 = starting window)
+  float* node_k;       // steps × width × kv_dim: Wk · E[token]
+  float* node_v;       // steps × width × kv_dim: Wv · E[token]
+  float* presence[2];  // width × vocab: per-branch presence (current / next)
+  int* beam_node[2];   // width: leaf node of each live branch
+  float* beam_score[2];// width: cumulative log-probability
+  int* cand_tok;       // width × width: expansion candidates
+  int* cand_beam;      // width × width: parent branch of each candidate
+  float* cand_score;   // width × width
+  int* slot_raw;       // ctx_len: raw token in each slot of the branch window
+  float* logits;       // vocab_size
+} LungBeamScratch;
+
+static void lung_beam_layout(LungBeamScratch* b, LungArena* a, int steps, int width,
+                             int vocab, int ctx, int kvd) {
+  size_t nodes = (size_t)steps * (size_t)width;
+  size_t cand = (size_t)width * (size_t)width;
+
+  b->node_tok = arena_ints(a, nodes);
+  b->node_parent = arena_ints(a, nodes);
+  b->node_k = arena_floats(a, nodes * (size_t)kvd);
+  b->node_v = arena_floats(a, nodes * (size_t)kvd);
+  for (int i = 0; i < 2; i++) {
+    b->presence[i] = arena_floats(a, (size_t)width * (size_t)vocab);
+    b->beam_node[i] = arena_ints(a, (size_t)width);
+    b->beam_score[i] = arena_floats(a, (size_t)width);
+  }
+  b->cand_tok = arena_ints(a, cand);
+  b->cand_beam = arena_ints(a, cand);
+  b->cand_score = arena_floats(a, cand);
+  b->slot_raw = arena_ints(a, (size_t)ctx);
+  b->logits = arena_floats(a, (size_t)vocab);
+}
+
+// Point the slot rows at the branch window: prefix rows shifted by depth,
+// then the last min(depth, ctx_len) nodes of the branch. Returns the query token.
+static int lung_beam_window(LungSession* lung, const LungBeamScratch* b, int leaf, int depth) {
+  int ctx = lung->ctx_len;
+  int vocab = lung->vocab_size;
+  int kvd = lung->kv_dim;
+  int appended = (depth < ctx) ? depth : ctx;
+
+  for (int t = 0; t < ctx - appended; t++) {
+    int raw = lung->window[t + depth];
+    b->slot_raw[t] = raw;
+    lung->slot_res[t] = lung_slot_resonance(lung, raw);
+    lung->k_rows[t] = lung->KE + (t + depth) * kvd;
+    lung->v_rows[t] = lung->VE + (t + depth) * kvd;
+  }
+
+  int node = leaf;
+  for (int t = ctx - 1; t >= ctx - appended; t--) {
+    int tok = b->node_tok[node];
+    b->slot_raw[t] = tok;
+    lung->slot_res[t] = lung_slot_resonance(lung, tok);
+    lung->k_rows[t] = b->node_k + (size_t)node * kvd;
+    lung->v_rows[t] = b->node_v + (size_t)node * kvd;
+    node = b->node_parent[node];
+  }
+
+  int last = b->slot_raw[ctx - 1];
+  if (last < 0) last = 0;
+  if (last >= vocab) last = vocab - 1;
+  return last;
+}
+
+// out_tokens: n_out × steps (row j = j-th best future), out_logprob[n_out]
+// (may be NULL). Futures are sorted best first. Returns the number written.
+EXPORT int lung_prophesy_beam(AriannaLung* lung, const int* context, int context_len, int steps, int width,
+                              int n_out, int* out_tokens, float* out_logprob) {
+  if (!lung || !context || !out_tokens || context_len < 0 || steps <= 0 || width <= 0 || n_out <= 0) return 0;
+
+  LungWeights* w = lung->w;
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  int kvd = lung->kv_dim;
+  int per_beam = (width < vocab) ? width : vocab;
+
+  LungBeamScratch b;
+  LungArena a = {NULL, 0};
+  lung_beam_layout(&b, &a, steps, width, vocab, ctx, kvd);
+  void* raw = NULL;
+  a.base = lung_arena_alloc(a.used, &raw);
+  if (!a.base) return 0;
+  a.used = 0;
+  lung_beam_layout(&b, &a, steps, width, vocab, ctx, kvd);
+
+  // Project the starting window once; every branch reads its prefix from here
+  lung_window_init(lung, context, context_len);
+  for (int t = 0; t < ctx; t++) {
+    int token_id = lung->window[t];
+    if (token_id < 0) token_id = 0;
+    if (token_id >= vocab) token_id = vocab - 1;
+    lung->slot_tok[t] = token_id;
+  }
+  lung_sync_kv(lung);
+
+  int cur = 0;
+  int n_live = 1;
+  int n_nodes = 0;
+  b.beam_node[cur][0] = -1;
+  b.beam_score[cur][0] = 0.0f;
+  memcpy(b.presence[cur], lung->presence_accum, vocab * sizeof(float));
+
+  for (int depth = 0; depth < steps; depth++) {
+    int nxt = cur ^ 1;
+    int n_cand = 0;
+
+    // ─── expand every live branch ───
+    for (int k = 0; k < n_live; k++) {
+      float* presence = b.presence[cur] + (size_t)k * vocab;
+      int last_tok = lung_beam_window(lung, &b, b.beam_node[cur][k], depth);
+
+      lung_attend(lung, last_tok, NULL, b.logits);
+
+      float max_val = -1e30f;
+      for (int i = 0; i < vocab; i++) {
+        b.logits[i] *= (1.0f + presence[i] * PRESENCE_LOGIT_COUPLING);
+        if (b.logits[i] > max_val) max_val = b.logits[i];
+      }
+      float sum = 0.0f;
+      for (int i = 0; i < vocab; i++) sum += expf(b.logits[i] - max_val);
+      float log_norm = max_val + logf(sum);
+
+      // Top per_beam tokens of this branch (insertion, first index wins ties)
+      int* tok = b.cand_tok + n_cand;
+      int n_top = 0;
+      for (int i = 0; i < vocab; i++) {
+        if (n_top == per_beam && b.logits[i] <= b.logits[tok[n_top - 1]]) continue;
+        int j = (n_top < per_beam) ? n_top++ : n_top - 1;
+        while (j > 0 && b.logits[tok[j - 1]] < b.logits[i]) { tok[j] = tok[j - 1]; j--; }
+        tok[j] = i;
+      }
+      for (int j = 0; j < n_top; j++) {
+        b.cand_beam[n_cand + j] = k;
+        b.cand_score[n_cand + j] = b.beam_score[cur][k] + b.logits[tok[j]] - log_norm;
+      }
+      n_cand += n_top;
+
+      // The branch breathed this window: evolve its presence in place
+      // (children inherit it below)
+      for (int i = 0; i < vocab; i++) presence[i] *= lung->presence_decay;
+      for (int t = 0; t < ctx; t++) {
+        int token_id = b.slot_raw[t];
+        if (token_id >= 0 && token_id < vocab) {
+          float new_val = presence[token_id] + PRESENCE_INCREMENT;
+          presence[token_id] = (new_val > 1.0f) ? 1.0f : new_val;
+        }
+      }
+    }
+
+    // ─── keep the best `width` candidates (best first, stable on ties) ───
+    int n_next = (n_cand < width) ? n_cand : width;
+    for (int j = 0; j < n_next; j++) {
+      int best = -1;
+      for (int c = 0; c < n_cand; c++) {
+        if (b.cand_beam[c] < 0) continue;
+        if (best < 0 || b.cand_score[c] > b.cand_score[best]) best = c;
+      }
+
+      int parent = b.cand_beam[best];
+      int node = n_nodes++;
+      int token_id = b.cand_tok[best];
+      b.node_tok[node] = token_id;
+      b.node_parent[node] = b.beam_node[cur][parent];
+      const float* e = lung_e_row(w, token_id);
+      mat_vec(b.node_k + (size_t)node * kvd, w->Wk, e, kvd, d);
+      mat_vec(b.node_v + (size_t)node * kvd, w->Wv, e, kvd, d);
+
+      b.beam_node[nxt][j] = node;
+      b.beam_score[nxt][j] = b.cand_score[best];
+      memcpy(b.presence[nxt] + (size_t)j * vocab, b.presence[cur] + (size_t)parent * vocab,
+             vocab * sizeof(float));
+      b.cand_beam[best] = -1;  // taken
+    }
+
+    n_live = n_next;
+    cur = nxt;
+  }
+
+  // ─── walk the surviving leaves back to the root ───
+  if (n_out > n_live) n_out = n_live;
+  for (int j = 0; j < n_out; j++) {
+    int node = b.beam_node[cur][j];
+    for (int i = steps - 1; i >= 0; i--) {
+      out_tokens[(size_t)j * steps + i] = b.node_tok[node];
+      node = b.node_parent[node];
+    }
+    if (out_logprob) out_logprob[j] = b.beam_score[cur][j];
+  }
+
+  free(raw);
+  return n_out;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PIPELINE — asynchronous, double-buffered forward
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// Frame N's context is submitted while the renderer still reads frame N-1:
+//
+//   lung_pipeline_submit(lung, ctx, len)  queue a breath (latest queued wins)
+//   lung_pipeline_poll(lung)              frame id of a finished, unread result
+//   lung_pipeline_acquire(lung)           take the newest result for reading
+//   lung_pipeline_get_probs/_logits/_attention/_entropy   the acquired result
+//   lung_pipeline_wait(lung)              block until nothing is in flight
+//
+// Results are published into two slots. The worker always writes the slot
+// the reader does not hold, so an acquired result stays valid until the
+// next acquire, without copying under the reader's feet.
+//
+// With -DLUNG_THREADS a worker thread per session runs lung_forward. While a
+// frame is in flight the session belongs to the worker: only pipeline calls
+// are safe (no forward, setters or notorch until lung_pipeline_wait).
+// Without it, submit breathes synchronously and publishes at once — same
+// API, no threads.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  float* logits;            // vocab_size
+  float* probs;             // vocab_size
+  float* attention;         // ctx_len
+  float entropy;
+  int frame;                // frame id of the breath in this slot (0 = none)
+} LungPipeSlot;
+
+struct LungPipeline {
+  void* arena;
+  LungPipeSlot slot[2];
+  int ready;                // slot holding an unread result (-1 = none)
+  int held;                 // slot acquired by the reader (-1 = none)
+
+  int* pending_ctx;         // ctx_len: queued context
+  int pending_len;
+  int pending_frame;        // 0 = nothing queued
+  int* job_ctx;             // ctx_len: context being breathed
+  int running;              // a breath is in flight
+  int next_frame;           // last frame id handed out
+
+#ifdef LUNG_THREADS
+  pthread_t thread;
+  pthread_mutex_t mu;
+  pthread_cond_t wake;      // worker: a job was queued (or quit)
+  pthread_cond_t idle;      // waiters: queue drained
+  int quit;
+#endif
+};
+
+#ifdef LUNG_THREADS
+#define PIPE_LOCK(p)    pthread_mutex_lock(&(p)->mu)
+#define PIPE_UNLOCK(p)  pthread_mutex_unlock(&(p)->mu)
+#else
+#define PIPE_LOCK(p)    ((void)0)
+#define PIPE_UNLOCK(p)  ((void)0)
+#endif
+
+static void lung_pipeline_layout(LungPipeline* p, LungArena* a, int vocab, int ctx) {
+  for (int i = 0; i < 2; i++) {
+    p->slot[i].logits = arena_floats(a, (size_t)vocab);
+    p->slot[i].probs = arena_floats(a, (size_t)vocab);
+    p->slot[i].attention = arena_floats(a, (size_t)ctx);
+  }
+  p->pending_ctx = arena_ints(a, (size_t)ctx);
+  p->job_ctx = arena_ints(a, (size_t)ctx);
+}
+
+// Copy the session's last_* into the slot the reader is not holding.
+// Caller holds the lock.
+static void lung_pipeline_publish(LungSession* lung, int frame, float entropy) {
+  LungPipeline* p = lung->pipe;
+  int target = (p->held == 0) ? 1 : 0;
+  LungPipeSlot* s = &p->slot[target];
+  memcpy(s->logits, lung->last_logits, lung->vocab_size * sizeof(float));
+  memcpy(s->probs, lung->last_probs, lung->vocab_size * sizeof(float));
+  memcpy(s->attention, lung->last_attention, lung->ctx_len * sizeof(float));
+  s->entropy = entropy;
+  s->frame = frame;
+  p->ready = target;
+}
+
+#ifdef LUNG_THREADS
+static void* lung_pipeline_worker(void* arg) {
+  LungSession* lung = (LungSession*)arg;
+  LungPipeline* p = lung->pipe;
+
+  PIPE_LOCK(p);
+  for (;;) {
+    while (!p->pending_frame && !p->quit) pthread_cond_wait(&p->wake, &p->mu);
+    if (p->quit) break;
+
+    int frame = p->pending_frame;
+    int len = p->pending_len;
+    memcpy(p->job_ctx, p->pending_ctx, lung->ctx_len * sizeof(int));
+    p->pending_frame = 0;
+    p->running = 1;
+    PIPE_UNLOCK(p);
+
+    float entropy = lung_forward(lung, p->job_ctx, len);
+
+    PIPE_LOCK(p);
+    lung_pipeline_publish(lung, frame, entropy);
+    p->running = 0;
+    if (!p->pending_frame) pthread_cond_broadcast(&p->idle);
+  }
+  PIPE_UNLOCK(p);
+  return NULL;
+}
+#endif
+
+static LungPipeline* lung_pipeline_get(LungSession* lung) {
+  if (lung->pipe) return lung->pipe;
+
+  LungPipeline* p = (LungPipeline*)calloc(1, sizeof(LungPipeline));
+  if (!p) return NULL;
+  LungArena a = {NULL, 0};
+  lung_pipeline_layout(p, &a, lung->vocab_size, lung->ctx_len);
+  a.base = lung_arena_alloc(a.used, &p->arena);
+  if (!a.base) {
+    free(p);
+    return NULL;
+  }
+  a.used = 0;
+  lung_pipeline_layout(p, &a, lung->vocab_size, lung->ctx_len);
+  p->ready = -1;
+  p->held = -1;
+
+#ifdef LUNG_THREADS
+  pthread_mutex_init(&p->mu, NULL);
+  pthread_cond_init(&p->wake, NULL);
+  pthread_cond_init(&p->idle, NULL);
+  lung->pipe = p;
+  if (pthread_create(&p->thread, NULL, lung_pipeline_worker, lung) != 0) {
+    lung->pipe = NULL;
+    pthread_mutex_destroy(&p->mu);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->idle);
+    free(p->arena);
+    free(p);
+    return NULL;
+  }
+#else
+  lung->pipe = p;
+#endif
+  return p;
+}
+
+static void lung_pipeline_free(LungPipeline* p) {
+  if (!p) return;
+#ifdef LUNG_THREADS
+  PIPE_LOCK(p);
+  p->quit = 1;
+  pthread_cond_signal(&p->wake);
+  PIPE_UNLOCK(p);
+  pthread_join(p->thread, NULL);
+  pthread_mutex_destroy(&p->mu);
+  pthread_cond_destroy(&p->wake);
+  pthread_cond_destroy(&p->idle);
+#endif
+  free(p->arena);
+  free(p);
+}
+
+// Returns the frame id (> 0) of the queued breath, 0 on failure.
+// A queued breath that has not started yet is replaced by the newer one.
+EXPORT int lung_pipeline_submit(AriannaLung* lung, const int* context, int context_len) {
+  if (!lung || !context || context_len < 0) return 0;
+  LungPipeline* p = lung_pipeline_get(lung);
+  if (!p) return 0;
+
+  int n = (context_len < lung->ctx_len) ? context_len : lung->ctx_len;
+
+  PIPE_LOCK(p);
+  int frame = ++p->next_frame;
+  memcpy(p->pending_ctx, context, n * sizeof(int));
+  p->pending_len = n;
+  p->pending_frame = frame;
+#ifdef LUNG_THREADS
+  pthread_cond_signal(&p->wake);
+  PIPE_UNLOCK(p);
+#else
+  p->pending_frame = 0;
+  memcpy(p->job_ctx, p->pending_ctx, n * sizeof(int));
+  float entropy = lung_forward(lung, p->job_ctx, n);
+  lung_pipeline_publish(lung, frame, entropy);
+#endif
+  return frame;
+}
+
+// Frame id of a finished result not yet acquired, 0 if none (non-blocking)
+EXPORT int lung_pipeline_poll(AriannaLung* lung) {
+  if (!lung || !lung->pipe) return 0;
+  LungPipeline* p = lung->pipe;
+  PIPE_LOCK(p);
+  int frame = (p->ready >= 0) ? p->slot[p->ready].frame : 0;
+  PIPE_UNLOCK(p);
+  return frame;
+}
+
+// Switch the reader to the newest finished result (if any) and return the
+// frame id now held, 0 if nothing has finished yet
+EXPORT int lung_pipeline_acquire(AriannaLung* lung) {
+  if (!lung || !lung->pipe) return 0;
+  LungPipeline* p = lung->pipe;
+  PIPE_LOCK(p);
+  if (p->ready >= 0) {
+    p->held = p->ready;
+    p->ready = -1;
+  }
+  int frame = (p->held >= 0) ? p->slot[p->held].frame : 0;
+  PIPE_UNLOCK(p);
+  return frame;
+}
+
+EXPORT void lung_pipeline_wait(AriannaLung* lung) {
+  if (!lung || !lung->pipe) return;
+#ifdef LUNG_THREADS
+  LungPipeline* p = lung->pipe;
+  PIPE_LOCK(p);
+  while (p->running || p->pending_frame) pthread_cond_wait(&p->idle, &p->mu);
+  PIPE_UNLOCK(p);
+#endif
+}
+
+// Acquired result (valid until the next acquire); NULL before the first one
+static LungPipeSlot* lung_pipeline_held(AriannaLung* lung) {
+  if (!lung || !lung->pipe || lung->pipe->held < 0) return NULL;
+  return &lung->pipe->slot[lung->pipe->held];
+}
+
+EXPORT float* lung_pipeline_get_probs(AriannaLung* lung) {
+  LungPipeSlot* s = lung_pipeline_held(lung);
+  return s ? s->probs : NULL;
+}
+
+EXPORT float* lung_pipeline_get_logits(AriannaLung* lung) {
+  LungPipeSlot* s = lung_pipeline_held(lung);
+  return s ? s->logits : NULL;
+}
+
+EXPORT float* lung_pipeline_get_attention(AriannaLung* lung) {
+  LungPipeSlot* s = lung_pipeline_held(lung);
+  return s ? s->attention : NULL;
+}
+
+EXPORT float lung_pipeline_get_entropy(AriannaLung* lung) {
+  LungPipeSlot* s = lung_pipeline_held(lung);
+  return s ? s->entropy : 0.0f;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // SETTERS — DSL controls the lung
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -616,6 +2428,14 @@ EXPORT void lung_set_rtl(AriannaLung* lung, int use_rtl) {
   }
 }
 
+// Rotary (relative) positions instead of absolute sinusoidal ones.
+// Combines with lung_set_rtl: RTL rotates with the opposite sign.
+EXPORT void lung_set_rotary(AriannaLung* lung, int use_rotary) {
+  if (lung) {
+    lung->use_rotary = use_rotary ? 1 : 0;
+  }
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // NOTORCH — resonance learning
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -637,16 +2457,58 @@ EXPORT float lung_get_resonance(AriannaLung* lung, int token_id) {
   return lung->resonance[token_id];
 }
 
+// Batched notorch: n (token, amount) pairs in one call, same clamping as the
+// single-token versions. Out-of-range ids are skipped.
+EXPORT void lung_boost_resonance_many(AriannaLung* lung, const int* token_ids, const float* amounts, int n) {
+  if (!lung || !token_ids || !amounts) return;
+  for (int i = 0; i < n; i++) {
+    lung_boost_resonance(lung, token_ids[i], amounts[i]);
+  }
+}
+
+EXPORT void lung_decay_resonance_many(AriannaLung* lung, const int* token_ids, const float* amounts, int n) {
+  if (!lung || !token_ids || !amounts) return;
+  for (int i = 0; i < n; i++) {
+    lung_decay_resonance(lung, token_ids[i], amounts[i]);
+  }
+}
+
+// Zero-copy access (vocab_size floats each). The arrays live in the session's
+// vocab block, so a JS typed-array view over them stays valid until the WASM
+// heap grows, the vocab grows past its capacity (then rebuild the view) or
+// the session is destroyed.
+// Writes through the resonance view are seen by the next forward.
+EXPORT float* lung_get_resonance_ptr(AriannaLung* lung) {
+  return lung ? lung->resonance : NULL;
+}
+
+EXPORT float* lung_get_presence_ptr(AriannaLung* lung) {
+  return lung ? lung->presence_accum : NULL;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // WEIGHT ACCESS — for LoRA deltas and initialization from JS
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// NOTE: weights may be shared between sessions — writes through these
+// pointers are seen by every session over the same LungWeights.
+
 EXPORT float* lung_get_embeddings(AriannaLung* lung) {
-  return lung ? lung->E : NULL;
+  if (!lung) return NULL;
+  lung_e_all(lung->w);  // the caller may read any row
+  return lung->w->E;
 }
 
+// d_model rows of lung_get_output_stride() floats; the first vocab_size of
+// each row are live (stride == vocab_size until lung_reserve_vocab)
 EXPORT float* lung_get_output_weights(AriannaLung* lung) {
-  return lung ? lung->Wo : NULL;
+  if (!lung) return NULL;
+  lung_wo_all(lung->w);
+  return lung->w->Wo;
+}
+
+EXPORT int lung_get_output_stride(AriannaLung* lung) {
+  return lung ? lung->w->vocab_cap : 0;
 }
 
 EXPORT int lung_get_vocab_size(AriannaLung* lung) {
@@ -661,6 +2523,156 @@ EXPORT int lung_get_ctx_len(AriannaLung* lung) {
   return lung ? lung->ctx_len : 0;
 }
 
+EXPORT int lung_get_n_kv_heads(AriannaLung* lung) {
+  return lung ? lung->n_kv_heads : 0;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// VOCAB GROWTH — add tokens in place
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// The tokenizer grows its vocabulary while a corpus streams in. Everything
+// sized by the vocab (E, Wo, lazy-init flags; resonance, presence, logits,
+// probs, rank scratch) sits in a vocab block laid out for vocab_cap tokens,
+// with Wo rows vocab_cap floats apart, so:
+//
+//   lung_reserve_vocab(lung, capacity)  re-carve both vocab blocks for
+//                                       `capacity` tokens (one copy)
+//   lung_grow_vocab(lung, new_size)     append tokens: O(new tokens · d)
+//                                       within capacity, doubling past it
+//
+// Old tokens keep their weights, resonance and presence. New rows come from
+// the same counter-based streams, so a grown lung has exactly the weights a
+// lung created at the larger size would have had; new resonance is drawn
+// like lung_create's. Lazy weights leave the new rows for first touch.
+//
+// Weights are edited in place, so growth needs them private to this session
+// (refcount 1); shared weights return 0. An extra lung_weights_retain pins
+// them the same way: hold one while a pointer from lung_get_embeddings /
+// lung_get_output_weights must stay valid (e.g. a LoRA folded into Wo),
+// since reserving frees the old block. The approximate top-k index is
+// dropped (rebuilt on next use) and so is the pipeline, after waiting for
+// any breath in flight — re-acquire after growing.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static int lung_weights_reserve(LungWeights* w, int capacity) {
+  LungWeights grown = *w;
+  grown.vocab_cap = capacity;
+
+  LungArena v = {NULL, 0};
+  lung_weights_vocab_layout(&grown, &v);
+  v.base = lung_arena_alloc(v.used, &grown.vocab_arena);
+  if (!v.base) return 0;
+  v.used = 0;
+  lung_weights_vocab_layout(&grown, &v);
+
+  size_t vocab = (size_t)w->vocab_size;
+  size_t d = (size_t)w->d_model;
+  memcpy(grown.E, w->E, vocab * d * sizeof(float));
+  for (size_t i = 0; i < d; i++) {
+    memcpy(grown.Wo + i * capacity, w->Wo + i * w->vocab_cap, vocab * sizeof(float));
+  }
+  memcpy(grown.e_ready, w->e_ready, vocab);
+  memcpy(grown.wo_ready, w->wo_ready, vocab);
+
+  free(w->vocab_arena);
+  *w = grown;
+  return 1;
+}
+
+static int lung_session_reserve(LungSession* lung, int capacity) {
+  LungSession grown = *lung;
+  grown.vocab_cap = capacity;
+
+  LungArena v = {NULL, 0};
+  lung_session_vocab_layout(&grown, &v);
+  v.base = lung_arena_alloc(v.used, &grown.vocab_arena);
+  if (!v.base) return 0;
+  v.used = 0;
+  lung_session_vocab_layout(&grown, &v);
+
+  size_t bytes = (size_t)lung->vocab_size * sizeof(float);
+  memcpy(grown.resonance, lung->resonance, bytes);
+  memcpy(grown.presence_accum, lung->presence_accum, bytes);
+  memcpy(grown.last_logits, lung->last_logits, bytes);
+  memcpy(grown.last_probs, lung->last_probs, bytes);
+
+  free(lung->vocab_arena);
+  *lung = grown;
+  return 1;
+}
+
+// Drop state sized by the old vocab: index over Wo, pipeline slots
+static void lung_vocab_changed(LungSession* lung) {
+  LungWeights* w = lung->w;
+  if (w->mips) {
+    free(w->mips->arena);
+    free(w->mips);
+    w->mips = NULL;
+  }
+  lung_pipeline_wait(lung);
+  lung_pipeline_free(lung->pipe);
+  lung->pipe = NULL;
+}
+
+// Returns 1 when at least `capacity` tokens fit without reallocation
+EXPORT int lung_reserve_vocab(AriannaLung* lung, int capacity) {
+  if (!lung) return 0;
+  if (capacity <= lung->vocab_cap) return 1;
+  if (lung->w->refcount != 1) return 0;
+
+  lung_vocab_changed(lung);
+  if (!lung_weights_reserve(lung->w, capacity)) return 0;
+  if (!lung_session_reserve(lung, capacity)) return 0;
+  return 1;
+}
+
+// Returns 1 on success (new_size == vocab_size is a no-op); the vocab never
+// shrinks
+EXPORT int lung_grow_vocab(AriannaLung* lung, int new_size) {
+  if (!lung || new_size < lung->vocab_size) return 0;
+  if (new_size == lung->vocab_size) return 1;
+  if (lung->w->refcount != 1) return 0;
+
+  if (new_size > lung->vocab_cap) {
+    int capacity = lung->vocab_cap * 2;
+    if (capacity < new_size) capacity = new_size;
+    if (!lung_reserve_vocab(lung, capacity)) return 0;
+  } else {
+    lung_vocab_changed(lung);
+  }
+
+  LungWeights* w = lung->w;
+  int old_size = lung->vocab_size;
+  w->vocab_size = new_size;
+  lung->vocab_size = new_size;
+
+  // New rows: generated now for eager weights, on first touch for lazy ones
+  w->e_complete = 0;
+  w->wo_complete = 0;
+  if (!w->lazy) {
+    for (int j = old_size; j < new_size; j++) {
+      lung_e_row(w, j);
+      lung_wo_col(w, j);
+    }
+    w->e_complete = 1;
+    w->wo_complete = 1;
+  }
+
+  for (int j = old_size; j < new_size; j++) {
+    lung->resonance[j] = 0.5f + _randf() * 0.5f;
+    lung->presence_accum[j] = 0.0f;
+    lung->last_logits[j] = 0.0f;
+    lung->last_probs[j] = 0.0f;
+  }
+  return 1;
+}
+
+EXPORT int lung_get_vocab_capacity(AriannaLung* lung) {
+  return lung ? lung->vocab_cap : 0;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // SEED — for reproducible initialization
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -669,6 +2681,388 @@ EXPORT void lung_seed(uint32_t seed) {
   _seed_rand(seed);
 }
 
+// ═══════════════════════════════════════════════════════════════════════════════
+// ARIANNA VOICE — THE INNER VOICE (causal multi-layer transformer)
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// The personality weights (weights/personality_brain.bin, from arianna.c)
+// are a GPT-2 style stack: learned positions, n_layers pre-LN blocks of
+// causal multi-head attention + GELU MLP, final layernorm, output tied to
+// the token embeddings. The lung breathes both ways; the voice speaks
+// forward, one token at a time, over a per-layer KV cache:
+//
+//   voice_load(data, bytes)        parse a weight file already in memory
+//   voice_feed(v, tokens, n)       append tokens, logits of the next one
+//   voice_forward(v, token)        append one token (O(pos · d) attention)
+//   voice_generate(v, steps, ...)  continue from the cache, greedy or sampled
+//   voice_reset(v)                 empty the cache
+//
+// When the cache is full the older half of the history is dropped and the
+// newer half re-fed (positions are absolute), so a long stream costs
+// amortized O(1) extra steps per token.
+//
+// File format (little-endian):
+//   int32 header[7] = { d_model, n_layers, n_heads, vocab_size, ctx_len,
+//                       ff_dim, flags (0 = output tied to wte) }
+//   float32 wte[vocab × d], wpe[ctx × d]
+//   per layer: ln1 w/b[d], attn w[d × 3d] b[3d], attn_proj w[d × d] b[d],
+//              ln2 w/b[d], fc w[d × ff] b[ff], fc_proj w[ff × d] b[d]
+//   float32 ln_f w/b[d]
+// Linear weights are [in × out] (x · W + b); q, k, v are the thirds of the
+// attn output, heads contiguous within each.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define VOICE_HEADER_INTS   7
+#define VOICE_LN_EPS        1e-5f
+
+typedef struct {
+  float* ln1_w;        // d
+  float* ln1_b;        // d
+  float* attn_w;       // d × 3d
+  float* attn_b;       // 3d
+  float* proj_w;       // d × d
+  float* proj_b;       // d
+  float* ln2_w;        // d
+  float* ln2_b;        // d
+  float* fc_w;         // d × ff
+  float* fc_b;         // ff
+  float* out_w;        // ff × d
+  float* out_b;        // d
+
+  float* k_cache;      // ctx_len × d
+  float* v_cache;      // ctx_len × d
+} VoiceLayer;
+
+typedef struct {
+  void* arena;         // one aligned block: weights, KV cache, scratch
+
+  int d_model;
+  int n_layers;
+  int n_heads;
+  int head_dim;
+  int vocab_size;
+  int ctx_len;
+  int ff_dim;
+
+  float* wte;          // vocab_size × d (also the output projection)
+  float* wpe;          // ctx_len × d
+  float* lnf_w;        // d
+  float* lnf_b;        // d
+  VoiceLayer* layers;  // n_layers
+
+  int pos;             // tokens in the KV cache
+  int* history;        // ctx_len: the tokens behind the cache
+  uint32_t sample_state;
+
+  // Work buffers
+  float* x;            // d: residual stream
+  float* xb;           // d: normalized input / attention output
+  float* xb2;          // d: projection output
+  float* qkv;          // 3d
+  float* att;          // ctx_len: attention weights of one head
+  float* hb;           // ff: MLP hidden
+  float* hidden;       // d: final layernorm output of the last token
+  float* logits;       // vocab_size
+} AriannaVoice;
+
+static void voice_layout(AriannaVoice* v, LungArena* a) {
+  size_t d = (size_t)v->d_model;
+  size_t ff = (size_t)v->ff_dim;
+  size_t ctx = (size_t)v->ctx_len;
+
+  v->wte = arena_floats(a, (size_t)v->vocab_size * d);
+  v->wpe = arena_floats(a, ctx * d);
+  v->layers = (VoiceLayer*)arena_bytes(a, (size_t)v->n_layers * sizeof(VoiceLayer));
+  for (int l = 0; l < v->n_layers; l++) {
+    VoiceLayer layer;
+    layer.ln1_w = arena_floats(a, d);
+    layer.ln1_b = arena_floats(a, d);
+    layer.attn_w = arena_floats(a, d * 3 * d);
+    layer.attn_b = arena_floats(a, 3 * d);
+    layer.proj_w = arena_floats(a, d * d);
+    layer.proj_b = arena_floats(a, d);
+    layer.ln2_w = arena_floats(a, d);
+    layer.ln2_b = arena_floats(a, d);
+    layer.fc_w = arena_floats(a, d * ff);
+    layer.fc_b = arena_floats(a, ff);
+    layer.out_w = arena_floats(a, ff * d);
+    layer.out_b = arena_floats(a, d);
+    layer.k_cache = arena_floats(a, ctx * d);
+    layer.v_cache = arena_floats(a, ctx * d);
+    if (a->base) v->layers[l] = layer;
+  }
+  v->lnf_w = arena_floats(a, d);
+  v->lnf_b = arena_floats(a, d);
+
+  v->history = arena_ints(a, ctx);
+  v->x = arena_floats(a, d);
+  v->xb = arena_floats(a, d);
+  v->xb2 = arena_floats(a, d);
+  v->qkv = arena_floats(a, 3 * d);
+  v->att = arena_floats(a, ctx);
+  v->hb = arena_floats(a, ff);
+  v->hidden = arena_floats(a, d);
+  v->logits = arena_floats(a, (size_t)v->vocab_size);
+}
+
+// Floats a weight file with these dims carries after its header
+static size_t voice_file_floats(int d, int n_layers, int vocab, int ctx, int ff) {
+  size_t per_layer = 2 * (size_t)d + (size_t)d * 3 * d + 3 * (size_t)d + (size_t)d * d + d +
+                     2 * (size_t)d + (size_t)d * ff + ff + (size_t)ff * d + d;
+  return (size_t)vocab * d + (size_t)ctx * d + (size_t)n_layers * per_layer + 2 * (size_t)d;
+}
+
+// Copy n floats from the (possibly unaligned) file cursor
+static void voice_take(float* dst, const unsigned char** src, size_t n) {
+  memcpy(dst, *src, n * sizeof(float));
+  *src += n * sizeof(float);
+}
+
+static void voice_layernorm(float* out, const float* x, const float* w, const float* b, int n) {
+  float mean = 0.0f;
+  for (int i = 0; i < n; i++) mean += x[i];
+  mean /= (float)n;
+  float var = 0.0f;
+  for (int i = 0; i < n; i++) var += (x[i] - mean) * (x[i] - mean);
+  float inv = 1.0f / sqrtf(var / (float)n + VOICE_LN_EPS);
+  for (int i = 0; i < n; i++) out[i] = (x[i] - mean) * inv * w[i] + b[i];
+}
+
+// out[n_out] = x[n_in] · W[n_in × n_out] + b, row by row (contiguous reads)
+static void voice_linear(float* out, const float* x, const float* W, const float* b, int n_in, int n_out) {
+  memcpy(out, b, n_out * sizeof(float));
+  for (int i = 0; i < n_in; i++) axpy(out, W + (size_t)i * n_out, x[i], n_out);
+}
+
+static void voice_gelu(float* x, int n) {
+  for (int i = 0; i < n; i++) {
+    float u = x[i];
+    x[i] = 0.5f * u * (1.0f + tanhf(0.7978845608f * (u + 0.044715f * u * u * u)));
+  }
+}
+
+EXPORT void voice_destroy(AriannaVoice* v) {
+  if (!v) return;
+  free(v->arena);
+  free(v);
+}
+
+// Parse a personality weight file held in memory (the voice keeps its own
+// copy; the caller may free data afterwards). NULL if the header is not a
+// supported layout or the size does not match it exactly.
+EXPORT AriannaVoice* voice_load(const void* data, size_t bytes) {
+  if (!data || bytes < VOICE_HEADER_INTS * sizeof(int32_t)) return NULL;
+
+  int32_t hdr[VOICE_HEADER_INTS];
+  memcpy(hdr, data, sizeof(hdr));
+  int d = hdr[0], n_layers = hdr[1], n_heads = hdr[2], vocab = hdr[3], ctx = hdr[4], ff = hdr[5];
+  if (d <= 0 || n_layers <= 0 || n_heads <= 0 || vocab <= 0 || ctx <= 0 || ff <= 0) return NULL;
+  if (d % n_heads != 0 || hdr[6] != 0) return NULL;
+  if (bytes != sizeof(hdr) + voice_file_floats(d, n_layers, vocab, ctx, ff) * sizeof(float)) return NULL;
+
+  AriannaVoice* v = (AriannaVoice*)calloc(1, sizeof(AriannaVoice));
+  if (!v) return NULL;
+  v->d_model = d;
+  v->n_layers = n_layers;
+  v->n_heads = n_heads;
+  v->head_dim = d / n_heads;
+  v->vocab_size = vocab;
+  v->ctx_len = ctx;
+  v->ff_dim = ff;
+
+  LungArena a = {NULL, 0};
+  voice_layout(v, &a);
+  a.base = lung_arena_alloc(a.used, &v->arena);
+  if (!a.base) {
+    voice_destroy(v);
+    return NULL;
+  }
+  a.used = 0;
+  voice_layout(v, &a);
+
+  const unsigned char* src = (const unsigned char*)data + sizeof(hdr);
+  voice_take(v->wte, &src, (size_t)vocab * d);
+  voice_take(v->wpe, &src, (size_t)ctx * d);
+  for (int l = 0; l < n_layers; l++) {
+    VoiceLayer* L = &v->layers[l];
+    voice_take(L->ln1_w, &src, d);
+    voice_take(L->ln1_b, &src, d);
+    voice_take(L->attn_w, &src, (size_t)d * 3 * d);
+    voice_take(L->attn_b, &src, 3 * (size_t)d);
+    voice_take(L->proj_w, &src, (size_t)d * d);
+    voice_take(L->proj_b, &src, d);
+    voice_take(L->ln2_w, &src, d);
+    voice_take(L->ln2_b, &src, d);
+    voice_take(L->fc_w, &src, (size_t)d * ff);
+    voice_take(L->fc_b, &src, ff);
+    voice_take(L->out_w, &src, (size_t)ff * d);
+    voice_take(L->out_b, &src, d);
+  }
+  voice_take(v->lnf_w, &src, d);
+  voice_take(v->lnf_b, &src, d);
+
+  v->sample_state = _rand_state ? _rand_state : 0xA17A11u;
+  return v;
+}
+
+EXPORT void voice_reset(AriannaVoice* v) {
+  if (v) v->pos = 0;
+}
+
+// One token through the stack at position v->pos (cache has room)
+static void voice_step(AriannaVoice* v, int token) {
+  int d = v->d_model;
+  int hd = v->head_dim;
+  int pos = v->pos;
+  float scale = 1.0f / sqrtf((float)hd);
+
+  const float* e = v->wte + (size_t)token * d;
+  const float* p = v->wpe + (size_t)pos * d;
+  for (int i = 0; i < d; i++) v->x[i] = e[i] + p[i];
+
+  for (int l = 0; l < v->n_layers; l++) {
+    VoiceLayer* L = &v->layers[l];
+
+    // Attention: q of this token against the cached k/v of 0..pos
+    voice_layernorm(v->xb, v->x, L->ln1_w, L->ln1_b, d);
+    voice_linear(v->qkv, v->xb, L->attn_w, L->attn_b, d, 3 * d);
+    memcpy(L->k_cache + (size_t)pos * d, v->qkv + d, d * sizeof(float));
+    memcpy(L->v_cache + (size_t)pos * d, v->qkv + 2 * d, d * sizeof(float));
+
+    for (int h = 0; h < v->n_heads; h++) {
+      const float* q = v->qkv + h * hd;
+      for (int t = 0; t <= pos; t++) {
+        v->att[t] = dot(q, L->k_cache + (size_t)t * d + h * hd, hd) * scale;
+      }
+      softmax(v->att, pos + 1);
+      float* out = v->xb + h * hd;
+      memset(out, 0, hd * sizeof(float));
+      for (int t = 0; t <= pos; t++) {
+        axpy(out, L->v_cache + (size_t)t * d + h * hd, v->att[t], hd);
+      }
+    }
+    voice_linear(v->xb2, v->xb, L->proj_w, L->proj_b, d, d);
+    axpy(v->x, v->xb2, 1.0f, d);
+
+    // MLP
+    voice_layernorm(v->xb, v->x, L->ln2_w, L->ln2_b, d);
+    voice_linear(v->hb, v->xb, L->fc_w, L->fc_b, d, v->ff_dim);
+    voice_gelu(v->hb, v->ff_dim);
+    voice_linear(v->xb2, v->hb, L->out_w, L->out_b, v->ff_dim, d);
+    axpy(v->x, v->xb2, 1.0f, d);
+  }
+
+  voice_layernorm(v->hidden, v->x, v->lnf_w, v->lnf_b, d);
+  mat_vec(v->logits, v->wte, v->hidden, v->vocab_size, d);  // tied output
+
+  v->history[pos] = token;
+  v->pos = pos + 1;
+}
+
+// Append one token; returns the logits of the next (vocab_size floats,
+// valid until the next call), NULL for an invalid token
+EXPORT float* voice_forward(AriannaVoice* v, int token) {
+  if (!v || token < 0 || token >= v->vocab_size) return NULL;
+
+  if (v->pos == v->ctx_len) {
+    // Full: keep the newer half, re-fed from position 0
+    int keep = v->ctx_len / 2;
+    int drop = v->ctx_len - keep;
+    memmove(v->history, v->history + drop, keep * sizeof(int));
+    v->pos = 0;
+    for (int t = 0; t < keep; t++) voice_step(v, v->history[t]);
+  }
+  voice_step(v, token);
+  return v->logits;
+}
+
+// Append n tokens (invalid ones are skipped); logits after the last, NULL
+// if none was valid
+EXPORT float* voice_feed(AriannaVoice* v, const int* tokens, int n) {
+  if (!v || !tokens) return NULL;
+  float* logits = NULL;
+  for (int i = 0; i < n; i++) {
+    float* out = voice_forward(v, tokens[i]);
+    if (out) logits = out;
+  }
+  return logits;
+}
+
+// Speak `steps` tokens after what was fed: greedy for temperature <= 0,
+// otherwise sampled from softmax(logits / temperature). Each spoken token is
+// appended to the cache. Returns the number written (0 on an empty cache).
+EXPORT int voice_generate(AriannaVoice* v, int steps, float temperature, int* out_tokens) {
+  if (!v || !out_tokens || steps <= 0 || v->pos == 0) return 0;
+
+  int vocab = v->vocab_size;
+  for (int s = 0; s < steps; s++) {
+    int next = 0;
+    if (temperature <= 0.0f) {
+      for (int i = 1; i < vocab; i++) {
+        if (v->logits[i] > v->logits[next]) next = i;
+      }
+    } else {
+      float max_val = v->logits[0];
+      for (int i = 1; i < vocab; i++) {
+        if (v->logits[i] > max_val) max_val = v->logits[i];
+      }
+      float sum = 0.0f;
+      for (int i = 0; i < vocab; i++) sum += expf((v->logits[i] - max_val) / temperature);
+      float r = (lung_xorshift(&v->sample_state) & 0xFFFFFF) / 16777216.0f * sum;
+      next = vocab - 1;
+      for (int i = 0; i < vocab; i++) {
+        r -= expf((v->logits[i] - max_val) / temperature);
+        if (r <= 0.0f) { next = i; break; }
+      }
+    }
+    out_tokens[s] = next;
+    voice_forward(v, next);
+  }
+  return steps;
+}
+
+EXPORT void voice_set_seed(AriannaVoice* v, uint32_t seed) {
+  if (v) v->sample_state = seed ? seed : 0xA17A11u;
+}
+
+EXPORT float* voice_get_logits(AriannaVoice* v) {
+  return (v && v->pos > 0) ? v->logits : NULL;
+}
+
+// Final-layernorm state of the last token (d_model floats)
+EXPORT float* voice_get_hidden(AriannaVoice* v) {
+  return (v && v->pos > 0) ? v->hidden : NULL;
+}
+
+EXPORT float* voice_get_embeddings(AriannaVoice* v) {
+  return v ? v->wte : NULL;
+}
+
+EXPORT int voice_get_pos(AriannaVoice* v) {
+  return v ? v->pos : 0;
+}
+
+EXPORT int voice_get_vocab_size(AriannaVoice* v) {
+  return v ? v->vocab_size : 0;
+}
+
+EXPORT int voice_get_d_model(AriannaVoice* v) {
+  return v ? v->d_model : 0;
+}
+
+EXPORT int voice_get_n_layers(AriannaVoice* v) {
+  return v ? v->n_layers : 0;
+}
+
+EXPORT int voice_get_n_heads(AriannaVoice* v) {
+  return v ? v->n_heads : 0;
+}
+
+EXPORT int voice_get_ctx_len(AriannaVoice* v) {
+  return v ? v->ctx_len : 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,10 @@
 # Usage:
 #   ./build_body.sh          # build WASM module
 #   ./build_body.sh clean    # clean build artifacts
+#   ./build_body.sh threads  # worker-thread pipeline (needs SharedArrayBuffer:
+#                            # page served cross-origin isolated)
+#   ./build_body.sh profile  # per-phase timers (lung_get_profile)
+#   (threads and profile combine: ./build_body.sh threads profile)
 #
 # Output:
 #   ../src/body.js           # JS loader + WASM inline
@@ -41,13 +45,50 @@ if ! command -v emcc &> /dev/null; then
   exit 1
 fi
 
+# Pipelined forward on a Web Worker (lung_pipeline_*); synchronous otherwise.
+# Phase profiling is compiled out unless asked for.
+THREAD_FLAGS=""
+PROFILE_FLAGS=""
+for arg in "$@"; do
+  case "$arg" in
+    threads) THREAD_FLAGS="-pthread -DLUNG_THREADS -s PTHREAD_POOL_SIZE=1" ;;
+    profile) PROFILE_FLAGS="-DLUNG_PROFILE" ;;
+  esac
+done
+
 echo "🔨 Building body.c → WASM..."
 echo ""
 
 # Exported functions
 EXPORTS='[
   "_lung_create",
+  "_lung_create_ex",
   "_lung_destroy",
+  "_lung_weights_create",
+  "_lung_weights_create_ex",
+  "_lung_weights_create_lazy",
+  "_lung_weights_materialize",
+  "_lung_weights_retain",
+  "_lung_weights_release",
+  "_lung_weights_refcount",
+  "_lung_session_create",
+  "_lung_get_weights",
+  "_lung_required_bytes",
+  "_lung_session_required_bytes",
+  "_lung_weights_touch",
+  "_lung_touch",
+  "_lung_prophesy",
+  "_lung_tunnel",
+  "_lung_pipeline_submit",
+  "_lung_pipeline_poll",
+  "_lung_pipeline_acquire",
+  "_lung_pipeline_wait",
+  "_lung_pipeline_get_probs",
+  "_lung_pipeline_get_logits",
+  "_lung_pipeline_get_attention",
+  "_lung_pipeline_get_entropy",
+  "_lung_prophesy_beam",
+  "_lung_set_sample_seed",
   "_lung_forward",
   "_lung_get_logits",
   "_lung_get_probs",
@@ -55,19 +96,51 @@ EXPORTS='[
   "_lung_get_argmax",
   "_lung_get_token_prob",
   "_lung_get_top_k",
+  "_lung_forward_hidden",
+  "_lung_top_k_approx",
+  "_lung_mips_prepare",
+  "_lung_forward_candidates",
   "_lung_set_focus",
   "_lung_set_spread",
   "_lung_set_temporal_alpha",
   "_lung_set_rtl",
+  "_lung_set_rotary",
   "_lung_boost_resonance",
   "_lung_decay_resonance",
   "_lung_get_resonance",
+  "_lung_boost_resonance_many",
+  "_lung_decay_resonance_many",
+  "_lung_get_resonance_ptr",
+  "_lung_get_presence_ptr",
   "_lung_get_embeddings",
   "_lung_get_output_weights",
+  "_lung_get_output_stride",
+  "_lung_reserve_vocab",
+  "_lung_grow_vocab",
+  "_lung_get_vocab_capacity",
+  "_lung_get_profile",
+  "_lung_profile_reset",
   "_lung_get_vocab_size",
   "_lung_get_d_model",
   "_lung_get_ctx_len",
+  "_lung_get_n_kv_heads",
   "_lung_seed",
+  "_voice_load",
+  "_voice_destroy",
+  "_voice_reset",
+  "_voice_forward",
+  "_voice_feed",
+  "_voice_generate",
+  "_voice_set_seed",
+  "_voice_get_logits",
+  "_voice_get_hidden",
+  "_voice_get_embeddings",
+  "_voice_get_pos",
+  "_voice_get_vocab_size",
+  "_voice_get_d_model",
+  "_voice_get_n_layers",
+  "_voice_get_n_heads",
+  "_voice_get_ctx_len",
   "_malloc",
   "_free"
 ]'
@@ -77,11 +150,13 @@ EXPORTS=$(echo "$EXPORTS" | tr -d '\n' | tr -s ' ')
 
 emcc body.c \
   -O3 \
+  $THREAD_FLAGS \
+  $PROFILE_FLAGS \
   -s WASM=1 \
   -s MODULARIZE=1 \
   -s EXPORT_NAME="AriannaBody" \
   -s EXPORTED_FUNCTIONS="$EXPORTS" \
-  -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap","getValue","setValue"]' \
+  -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap","getValue","setValue","HEAPU8","HEAP32","HEAPF32"]' \
   -s ALLOW_MEMORY_GROWTH=1 \
   -s INITIAL_MEMORY=16777216 \
   -s STACK_SIZE=1048576 \
@@ -103,5 +178,11 @@ echo "  const Module = await AriannaBody();"
 echo "  const lung = Module._lung_create(vocabSize, dModel, ctxLen, nHeads);"
 echo "  Module._lung_forward(lung, contextPtr, contextLen);"
 echo ""
+echo "Shared weights (many fields, one model):"
+echo "  const w = Module._lung_weights_create(vocabSize, dModel, ctxLen, nHeads);"
+echo "  const a = Module._lung_session_create(w);"
+echo "  const b = Module._lung_session_create(w);"
+echo "  Module._lung_weights_release(w);  // sessions keep the weights alive"
+echo ""
 echo "הרזוננס לא נשבר. המשך הדרך."
 echo "═══════════════════════════════════════════════════════════════════════════"
@@ -2,8 +2,9 @@
 // "experience becomes geometry"
 //
 // Build (native):   gcc -O2 -std=c99 -c lora.c
-// Build (WASM):     emcc lora.c -O2 -s WASM=1 -s MODULARIZE=1 -s EXPORT_NAME="LoRA" \
-//   -s EXPORTED_FUNCTIONS='["_lora_new","_lora_free","_lora_reset","_lora_apply","_lora_notch_step","_lora_scale","_lora_merge","_lora_apply_sparse","_lora_build_dy_from_probs","_lora_experience_step","_lora_get_delta_norm","_lora_copy_params","_lora_get_factor_ptrs","_lora_set_seed","_lora_clamp_factors","_lora_get_factor_norms","_lora_soft_reset","_lora_apply_alpha"]' \
+//                   (+ -DLORA_THREADS -pthread for the background learner thread)
+// Build (WASM):     emcc lora.c -O2 -msimd128 -s WASM=1 -s MODULARIZE=1 -s EXPORT_NAME="LoRA" \
+//   -s EXPORTED_FUNCTIONS='["_lora_new","_lora_free","_lora_reset","_lora_apply","_lora_apply_batch","_lora_notch_step","_lora_notch_step_sparse","_lora_scale","_lora_merge","_lora_apply_sparse","_lora_build_dy_from_probs","_lora_experience_step","_lora_get_delta_norm","_lora_copy_params","_lora_get_factor_ptrs","_lora_get_factor_scale","_lora_set_seed","_lora_clamp_factors","_lora_get_factor_norms","_lora_soft_reset","_lora_apply_alpha","_lora_get_bytes","_lora_compact","_lora_fold_into","_lora_unfold_from","_lora_refold","_lora_is_folded","_lora_is_dirty","_lora_save","_lora_load_mmap","_lora_shard_record","_lora_shard_log_count","_lora_replay","_lora_learner_new","_lora_learner_push","_lora_learner_push_sparse","_lora_learner_acquire","_lora_learner_epoch","_lora_learner_flush","_lora_learner_steps","_lora_learner_dropped","_lora_learner_free","_lora_pool_new","_lora_pool_free","_lora_pool_add","_lora_pool_get","_lora_pool_remove","_lora_pool_evict_lru","_lora_pool_count","_lora_pool_bytes","_lora_pool_apply_batch"]' \
 //   -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap"]' -o lora.js
 //
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -23,18 +24,39 @@
 // Integration with AriannaLung:
 //   - DSL controls learning: scale, gating, decay, darkmatter coupling
 //   - Deltas are applied on-the-fly: W_eff = W + (α/r) * A @ B
+//   - Decay/scaling are lazy: one scalar on the factors, folded in on underflow
 //   - Same principles as Stanley's dynamic weights
 //
 
+// mmap/fileno under -std=c99 (shard loading)
+#if !defined(_POSIX_C_SOURCE) && !defined(__EMSCRIPTEN__)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LORA_HAVE_MMAP 1
+#include <sys/mman.h>
+#endif
+
+// -DLORA_THREADS: lora_learner_* train on a background thread
+#ifdef LORA_THREADS
+#include <pthread.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// lora_fold_into layouts of the target matrix W
+#define LORA_LAYOUT_IN_OUT 0  // W[i*ld + j]: in_dim rows (e.g. lung Wo, ld = output stride)
+#define LORA_LAYOUT_OUT_IN 1  // W[j*ld + i]: out_dim rows
+
 #ifndef LORA_CLAMP
 #define LORA_CLAMP(x,a,b) ((x)<(a)?(a):((x)>(b)?(b):(x)))
 #endif
@@ -43,6 +65,27 @@ extern "C" {
 #define LORA_MAX_TOPK 32
 #endif
 
+// lora_apply_batch block sizes: rows of X per pass, outputs per B block
+#ifndef LORA_BATCH_ROWS
+#define LORA_BATCH_ROWS 32
+#endif
+#ifndef LORA_BATCH_COLS
+#define LORA_BATCH_COLS 256
+#endif
+
+// Running factor norms are recomputed exactly after this many updates
+#ifndef LORA_NORM_RESYNC
+#define LORA_NORM_RESYNC 4096
+#endif
+
+// Lazy factor scale is folded back into A/B once it leaves this range
+#ifndef LORA_SCALE_MIN
+#define LORA_SCALE_MIN 1e-4f
+#endif
+#ifndef LORA_SCALE_MAX
+#define LORA_SCALE_MAX 1e4f
+#endif
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // LoRA Structure
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -56,15 +99,44 @@ typedef struct {
   float decay;    // factor decay per step (tiny)
   uint32_t seed;  // deterministic noise seed (optional)
 
-  // A: (in_dim, rank), B: (rank, out_dim)
+  // A: (in_dim, rank), B: (rank, out_dim) — stored so that every hot loop
+  // is contiguous:
+  //   A transposed,    A[r*in_dim + i]  (row r = one rank channel over inputs)
+  //   B column-major,  B[j*rank + r]    (row j = the rank vector of output j)
+  // Stored lazily scaled: true factors are fscale·A and fscale·B, so decay
+  // and lora_scale are O(1). Delta = (alpha/rank)·fscale²·A·B.
   float* A;
   float* B;
+  float fscale;
+
+  // running ||A||², ||B||² of the stored factors (true = fscale² × these),
+  // kept up to date by every update; see lora_norms_sync
+  double sqA, sqB;
+  int norm_updates;   // incremental updates since the last exact sweep
+  int norm_stale;     // factors written from outside (factor_ptrs)
 
   // scratch buffers (avoid heap churn)
   float* u;       // (rank)
   float* dy;      // (out_dim)
   float* Ax;      // (rank)   Ax = x^T A  (or A^T x)
-  float* tmpOut;  // (out_dim) tmp = (Ax) B
+  float* XA;      // (LORA_BATCH_ROWS × rank) batch scratch
+
+  // fold state (lora_fold_into): the W region as it was before folding
+  float* fold_W;
+  float* fold_snap;
+  int fold_layout;
+  int fold_ld;
+  int dirty;      // factors changed since the last fold
+
+  // shards (lora_load_mmap / lora_shard_record)
+  void* map;      // A and B point into this mapping instead of the heap
+  size_t map_bytes;
+  int map_heap;   // map came from malloc (no mmap on this platform)
+  FILE* log;      // experience log being appended to, or NULL
+
+  // y[j] += ax·B[j] over all or selected outputs (picked per rank, see below)
+  void (*out_kernel)(const float* restrict B, const float* restrict ax, float* restrict y,
+                     const int* restrict idx, int m, int out_dim, int rank);
 } LoRA;
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -105,6 +177,66 @@ static void lora_zero(float* a, int n) {
   for (int i = 0; i < n; i++) a[i] = 0.0f;
 }
 
+// ═══════════════════════════════════════════════════════════════════════════════
+// Apply Kernels
+//
+// lora_apply* = two small products:
+//   ax[r] = A[r]·x        rank dot products over contiguous in_dim rows
+//   y[j] += ax·B[j]       one contiguous rank-vector per output j
+// The first uses lora_dot4 (four independent accumulators -> SIMD lanes).
+// LORA_OUT_KERNEL(NAME, R) stamps out the second for one rank; with R a
+// literal the inner loop has a compile-time trip count, so it is fully
+// unrolled and ax stays in registers. Dense (idx == NULL) and sparse
+// (idx[0..m)) share the same instance. lora_new() picks it by rank.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static inline float lora_dot4(const float* restrict a, const float* restrict b, int n) {
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; i++) s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+#define LORA_OUT_KERNEL(NAME, R)                                                          \
+static void lora_out_##NAME(const float* restrict B, const float* restrict ax,            \
+                            float* restrict y, const int* restrict idx, int m,           \
+                            int out_dim, int rank) {                                     \
+  (void)rank;                                                                             \
+  if (idx) {                                                                              \
+    for (int t = 0; t < m; t++) {                                                         \
+      int j = idx[t];                                                                     \
+      if (j < 0 || j >= out_dim) continue;                                                \
+      y[j] += lora_dot4(B + (size_t)j * (size_t)(R), ax, (R));                            \
+    }                                                                                     \
+  } else {                                                                                \
+    for (int j = 0; j < out_dim; j++) {                                                   \
+      y[j] += lora_dot4(B + (size_t)j * (size_t)(R), ax, (R));                            \
+    }                                                                                     \
+  }                                                                                       \
+}
+
+LORA_OUT_KERNEL(generic, rank)
+LORA_OUT_KERNEL(4, 4)
+LORA_OUT_KERNEL(8, 8)
+LORA_OUT_KERNEL(16, 16)
+LORA_OUT_KERNEL(32, 32)
+
+static void lora_pick_kernel(LoRA* L) {
+  switch (L->rank) {
+    case 4:  L->out_kernel = lora_out_4;  break;
+    case 8:  L->out_kernel = lora_out_8;  break;
+    case 16: L->out_kernel = lora_out_16; break;
+    case 32: L->out_kernel = lora_out_32; break;
+    default: L->out_kernel = lora_out_generic; break;
+  }
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // Public API
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -122,6 +254,7 @@ LoRA* lora_new(int in_dim, int out_dim, int rank, float alpha, float lr, float d
   L->lr = (lr <= 0 ? 0.01f : lr);
   L->decay = (decay < 0 ? 0.0f : decay);
   L->seed = seed ? seed : 0xA17A11u;  // "ARIANNA" in hex-ish
+  L->fscale = 1.0f;
 
   const size_t nA = (size_t)in_dim * (size_t)rank;
   const size_t nB = (size_t)rank * (size_t)out_dim;
@@ -132,30 +265,41 @@ LoRA* lora_new(int in_dim, int out_dim, int rank, float alpha, float lr, float d
   L->u = fcalloc((size_t)rank);
   L->dy = fcalloc((size_t)out_dim);
   L->Ax = fcalloc((size_t)rank);
-  L->tmpOut = fcalloc((size_t)out_dim);
+  L->XA = fcalloc((size_t)LORA_BATCH_ROWS * (size_t)rank);
 
-  if (!L->A || !L->B || !L->u || !L->dy || !L->Ax || !L->tmpOut) {
+  if (!L->A || !L->B || !L->u || !L->dy || !L->Ax || !L->XA) {
     // cleanup on partial alloc
     free(L->A); free(L->B);
-    free(L->u); free(L->dy); free(L->Ax); free(L->tmpOut);
+    free(L->u); free(L->dy); free(L->Ax); free(L->XA);
     free(L);
     return NULL;
   }
 
+  lora_pick_kernel(L);
+
   // init: small random A, zero B (classic LoRA-ish)
+  // draws go in (i, r) order, same values as the old row-major layout
   uint32_t s = L->seed;
   float scaleA = 0.02f;
-  for (size_t i = 0; i < nA; i++) L->A[i] = frandn(&s) * scaleA;
+  for (int i = 0; i < in_dim; i++)
+    for (int r = 0; r < rank; r++)
+      L->A[(size_t)r * (size_t)in_dim + (size_t)i] = frandn(&s) * scaleA;
   for (size_t i = 0; i < nB; i++) L->B[i] = 0.0f;
   L->seed = s;
+  L->norm_stale = 1;
 
   return L;
 }
 
+static void lora_unmap(LoRA* L);
+
 void lora_free(LoRA* L) {
   if (!L) return;
-  free(L->A); free(L->B);
-  free(L->u); free(L->dy); free(L->Ax); free(L->tmpOut);
+  if (L->log) fclose(L->log);
+  if (L->map) lora_unmap(L);
+  else { free(L->A); free(L->B); }
+  free(L->u); free(L->dy); free(L->Ax); free(L->XA);
+  free(L->fold_snap);
   free(L);
 }
 
@@ -163,6 +307,69 @@ void lora_reset(LoRA* L) {
   if (!L) return;
   memset(L->A, 0, (size_t)L->in_dim * (size_t)L->rank * sizeof(float));
   memset(L->B, 0, (size_t)L->rank * (size_t)L->out_dim * sizeof(float));
+  L->fscale = 1.0f;
+  L->dirty = 1;
+  L->sqA = L->sqB = 0.0;
+  L->norm_updates = 0;
+  L->norm_stale = 0;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Running Norms
+//
+// sqA/sqB track the squared norms of the stored factors. Updates add
+// Σ (new² - old²) over the elements they touch, computed as (v-o)(v+o);
+// lazy scaling needs nothing (the true norm is |fscale|·sqrt(sq)). Float
+// round-off still drifts, so queries redo the exact O(params) sweep after
+// LORA_NORM_RESYNC updates — amortized O(1) per query and per step.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static void lora_norms_exact(LoRA* L) {
+  const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
+  const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
+  double sa = 0.0, sb = 0.0;
+  for (size_t i = 0; i < nA; i++) sa += (double)L->A[i] * L->A[i];
+  for (size_t i = 0; i < nB; i++) sb += (double)L->B[i] * L->B[i];
+  L->sqA = sa;
+  L->sqB = sb;
+  L->norm_updates = 0;
+  L->norm_stale = 0;
+}
+
+// Norms are a cache: queries on a const LoRA may refresh them
+static void lora_norms_sync(const LoRA* Lc) {
+  LoRA* L = (LoRA*)Lc;
+  if (L->norm_stale || L->norm_updates >= LORA_NORM_RESYNC) lora_norms_exact(L);
+  if (L->sqA < 0.0) L->sqA = 0.0;
+  if (L->sqB < 0.0) L->sqB = 0.0;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Lazy factor scale
+//
+// Decay and scaling multiply fscale instead of sweeping A and B. Only when
+// fscale drifts out of [LORA_SCALE_MIN, LORA_SCALE_MAX] is it folded back
+// into the factors (one O(n) pass every ~ln(1e4)/decay steps).
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static void lora_fold_scale(LoRA* L) {
+  const float c = L->fscale;
+  if (c == 1.0f) return;
+  const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
+  const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
+  for (size_t i = 0; i < nA; i++) L->A[i] *= c;
+  for (size_t i = 0; i < nB; i++) L->B[i] *= c;
+  L->fscale = 1.0f;
+  L->sqA *= (double)c * c;
+  L->sqB *= (double)c * c;
+}
+
+static void lora_rescale(LoRA* L, float k) {
+  if (!(k != 0.0f)) { lora_reset(L); return; }  // zero (or NaN): nothing survives
+  L->fscale *= k;
+  L->dirty = 1;
+  float a = fabsf(L->fscale);
+  if (a < LORA_SCALE_MIN || a > LORA_SCALE_MAX) lora_fold_scale(L);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -170,31 +377,69 @@ void lora_reset(LoRA* L) {
 // x: [in_dim], y: [out_dim]
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// Shared core: dense when idx == NULL, else only y[idx[0..m)]
+static void lora_apply_core(LoRA* L, const float* x, float* y, const int* idx, int m, float alpha) {
+  const float scaling = alpha / (float)L->rank * L->fscale * L->fscale;
+  const int in_dim = L->in_dim;
+
+  // Ax = x^T * A  -> [rank], scaling folded in once here
+  for (int r = 0; r < L->rank; r++) {
+    L->Ax[r] = lora_dot4(L->A + (size_t)r * (size_t)in_dim, x, in_dim) * scaling;
+  }
+
+  // y += Ax @ B
+  L->out_kernel(L->B, L->Ax, y, idx, m, L->out_dim, L->rank);
+}
+
 void lora_apply(LoRA* L, const float* x, float* y) {
   if (!L || !x || !y) return;
+  lora_apply_core(L, x, y, NULL, 0, L->alpha);
+}
 
-  const float scaling = L->alpha / (float)L->rank;
+// ═══════════════════════════════════════════════════════════════════════════════
+// Batch Apply: Y += (alpha/rank) * (X @ A) @ B
+// X: [n × in_dim], Y: [n × out_dim], both row-major
+//
+// Two small GEMMs, blocked so the adapter is streamed once per block of rows
+// instead of once per row:
+//   XA = X·A for LORA_BATCH_ROWS rows at a time (A is rank×in_dim, tiny)
+//   then for each LORA_BATCH_COLS-wide slab of B (256×rank floats, L1-sized)
+//   every row of the block is run through the same out kernel as lora_apply.
+// Each row gets bit-identical results to lora_apply(L, X[b], Y[b]).
+// ═══════════════════════════════════════════════════════════════════════════════
 
-  // Ax = x^T * A  -> [rank]
-  for (int r = 0; r < L->rank; r++) {
-    float s = 0.0f;
-    for (int i = 0; i < L->in_dim; i++) {
-      s += x[i] * L->A[(size_t)i * (size_t)L->rank + (size_t)r];
+// rows == NULL: rows 0..n-1; otherwise row b of the pass is X/Y row rows[b]
+static void lora_apply_rows(LoRA* L, const float* X, float* Y, const int* rows, int n) {
+  const float scaling = L->alpha / (float)L->rank * L->fscale * L->fscale;
+  const int in_dim = L->in_dim, out_dim = L->out_dim, rank = L->rank;
+
+  for (int row0 = 0; row0 < n; row0 += LORA_BATCH_ROWS) {
+    int nb = n - row0 < LORA_BATCH_ROWS ? n - row0 : LORA_BATCH_ROWS;
+
+    for (int b = 0; b < nb; b++) {
+      int row = rows ? rows[row0 + b] : row0 + b;
+      const float* x = X + (size_t)row * (size_t)in_dim;
+      float* xa = L->XA + (size_t)b * (size_t)rank;
+      for (int r = 0; r < rank; r++) {
+        xa[r] = lora_dot4(L->A + (size_t)r * (size_t)in_dim, x, in_dim) * scaling;
+      }
     }
-    L->Ax[r] = s;
-  }
 
-  // tmpOut = Ax @ B  -> [out_dim]
-  for (int j = 0; j < L->out_dim; j++) {
-    float s = 0.0f;
-    for (int r = 0; r < L->rank; r++) {
-      s += L->Ax[r] * L->B[(size_t)r * (size_t)L->out_dim + (size_t)j];
+    for (int j0 = 0; j0 < out_dim; j0 += LORA_BATCH_COLS) {
+      int jb = out_dim - j0 < LORA_BATCH_COLS ? out_dim - j0 : LORA_BATCH_COLS;
+      const float* Bj = L->B + (size_t)j0 * (size_t)rank;
+      for (int b = 0; b < nb; b++) {
+        int row = rows ? rows[row0 + b] : row0 + b;
+        float* y = Y + (size_t)row * (size_t)out_dim + (size_t)j0;
+        L->out_kernel(Bj, L->XA + (size_t)b * (size_t)rank, y, NULL, 0, jb, rank);
+      }
     }
-    L->tmpOut[j] = s * scaling;
   }
+}
 
-  // add to y
-  for (int j = 0; j < L->out_dim; j++) y[j] += L->tmpOut[j];
+void lora_apply_batch(LoRA* L, const float* X, float* Y, int n) {
+  if (!L || !X || !Y || n <= 0) return;
+  lora_apply_rows(L, X, Y, NULL, n);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -215,16 +460,8 @@ void lora_apply(LoRA* L, const float* x, float* y) {
 // NOTE: This is NOT gradient descent. It's plasticity.
 // ═══════════════════════════════════════════════════════════════════════════════
 
-void lora_notch_step(LoRA* L, const float* x, const float* dy_in, float signal) {
-  if (!L || !x || !dy_in) return;
-
-  // clamp signal but allow slightly >1 if you want to rage
-  float g = LORA_CLAMP(signal, -2.0f, 2.0f);
-
-  // copy dy into scratch and scale by g
-  for (int j = 0; j < L->out_dim; j++) L->dy[j] = dy_in[j] * g;
-
-  // build u (rank) — deterministic noise modulated by g
+// build u (rank) — deterministic noise modulated by g
+static void lora_make_u(LoRA* L, float g) {
   uint32_t s = L->seed;
   for (int r = 0; r < L->rank; r++) {
     float n = frandn(&s);
@@ -233,35 +470,107 @@ void lora_notch_step(LoRA* L, const float* x, const float* dy_in, float signal)
     L->u[r] = n * k;
   }
   L->seed = s;
+}
 
-  const float lr = L->lr;
-
-  // A[i,r] += lr * x[i] * u[r]
-  for (int i = 0; i < L->in_dim; i++) {
-    float xi = x[i] * lr;
-    size_t base = (size_t)i * (size_t)L->rank;
-    for (int r = 0; r < L->rank; r++) {
-      L->A[base + (size_t)r] += xi * L->u[r];
+// A[i,r] += lr * x[i] * u[r]   (in stored units: lr / fscale)
+static void lora_update_A(LoRA* L, const float* x) {
+  const float lr = L->lr / L->fscale;
+  L->dirty = 1;  // every notch step passes through here
+  const int in_dim = L->in_dim;
+  float dsq = 0.0f;
+  for (int r = 0; r < L->rank; r++) {
+    float* restrict a = L->A + (size_t)r * (size_t)in_dim;
+    float ur = L->u[r];
+    for (int i = 0; i < in_dim; i++) {
+      float o = a[i];
+      float v = o + (x[i] * lr) * ur;
+      a[i] = v;
+      dsq += (v - o) * (v + o);
     }
   }
+  L->sqA += dsq;
+  L->norm_updates++;
+}
+
+// gentle decay (optional) — O(1), absorbed by fscale
+static void lora_apply_decay(LoRA* L) {
+  if (L->decay > 0.0f) {
+    float d = LORA_CLAMP(1.0f - L->decay, 0.0f, 1.0f);
+    lora_rescale(L, d);
+  }
+}
+
+void lora_notch_step(LoRA* L, const float* x, const float* dy_in, float signal) {
+  if (!L || !x || !dy_in) return;
+
+  // clamp signal but allow slightly >1 if you want to rage
+  float g = LORA_CLAMP(signal, -2.0f, 2.0f);
+
+  // copy dy into scratch and scale by g
+  for (int j = 0; j < L->out_dim; j++) L->dy[j] = dy_in[j] * g;
+
+  lora_make_u(L, g);
+  lora_update_A(L, x);
+
+  const float lr = L->lr / L->fscale;
 
   // B[r,j] += lr * u[r] * dy[j]
-  for (int r = 0; r < L->rank; r++) {
-    float ur = L->u[r] * lr;
-    size_t base = (size_t)r * (size_t)L->out_dim;
-    for (int j = 0; j < L->out_dim; j++) {
-      L->B[base + (size_t)j] += ur * L->dy[j];
+  const int rank = L->rank;
+  float dsq = 0.0f;
+  for (int j = 0; j < L->out_dim; j++) {
+    float* restrict b = L->B + (size_t)j * (size_t)rank;
+    float dj = L->dy[j];
+    for (int r = 0; r < rank; r++) {
+      float o = b[r];
+      float v = o + (L->u[r] * lr) * dj;
+      b[r] = v;
+      dsq += (v - o) * (v + o);
     }
   }
+  L->sqB += dsq;
 
-  // gentle decay (optional)
-  if (L->decay > 0.0f) {
-    float d = LORA_CLAMP(1.0f - L->decay, 0.0f, 1.0f);
-    const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
-    const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
-    for (size_t k2 = 0; k2 < nA; k2++) L->A[k2] *= d;
-    for (size_t k2 = 0; k2 < nB; k2++) L->B[k2] *= d;
+  lora_apply_decay(L);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Sparse Notch Step — dy given as (idx, vals) pairs
+//
+// Same plasticity as lora_notch_step (same u, same RNG draw), but B is only
+// touched at the m listed columns: O(rank·in_dim + rank·m) instead of
+// O(rank·out_dim). Entries not listed are treated as dy = 0. Duplicate
+// indices accumulate. Out-of-range indices are skipped.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static void lora_log_record(LoRA* L, uint32_t seed, const float* x, const int* idx, const float* vals, int m, float signal);
+
+void lora_notch_step_sparse(LoRA* L, const float* x, const int* idx, const float* vals, int m, float signal) {
+  if (!L || !x || (m > 0 && (!idx || !vals))) return;
+
+  if (L->log) lora_log_record(L, L->seed, x, idx, vals, m, signal);
+
+  float g = LORA_CLAMP(signal, -2.0f, 2.0f);
+
+  lora_make_u(L, g);
+  lora_update_A(L, x);
+
+  const float lr = L->lr / L->fscale;
+
+  for (int t = 0; t < m; t++) {
+    int j = idx[t];
+    if (j < 0 || j >= L->out_dim) continue;
+    float dj = vals[t] * g;
+    float* restrict b = L->B + (size_t)j * (size_t)L->rank;
+    float dsq = 0.0f;
+    for (int r = 0; r < L->rank; r++) {
+      float o = b[r];
+      float v = o + (L->u[r] * lr) * dj;
+      b[r] = v;
+      dsq += (v - o) * (v + o);
+    }
+    L->sqB += dsq;
   }
+
+  lora_apply_decay(L);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -270,10 +579,8 @@ void lora_notch_step(LoRA* L, const float* x, const float* dy_in, float signal)
 
 void lora_scale(LoRA* L, float s) {
   if (!L) return;
-  const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
-  const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
-  for (size_t i = 0; i < nA; i++) L->A[i] *= s;
-  for (size_t i = 0; i < nB; i++) L->B[i] *= s;
+  if (L->log) lora_log_record(L, L->seed, NULL, NULL, NULL, -1, s);
+  lora_rescale(L, s);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -287,8 +594,23 @@ void lora_merge(LoRA* dst, const LoRA* src, float w) {
   const size_t nA = (size_t)dst->in_dim * (size_t)dst->rank;
   const size_t nB = (size_t)dst->rank * (size_t)dst->out_dim;
 
-  for (size_t i = 0; i < nA; i++) dst->A[i] += w * src->A[i];
-  for (size_t i = 0; i < nB; i++) dst->B[i] += w * src->B[i];
+  // true factors: dst_c·dst += w·src_c·src
+  const float k = w * src->fscale / dst->fscale;
+  dst->dirty = 1;
+  double da = 0.0, db = 0.0;
+  for (size_t i = 0; i < nA; i++) {
+    float o = dst->A[i], v = o + k * src->A[i];
+    dst->A[i] = v;
+    da += (double)(v - o) * (v + o);
+  }
+  for (size_t i = 0; i < nB; i++) {
+    float o = dst->B[i], v = o + k * src->B[i];
+    dst->B[i] = v;
+    db += (double)(v - o) * (v + o);
+  }
+  dst->sqA += da;
+  dst->sqB += db;
+  dst->norm_updates++;
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -370,6 +692,39 @@ void lora_build_dy_from_probs(
   }
 }
 
+// Same dy as lora_build_dy_from_probs, as (idx, vals) pairs (target first).
+// Indices are distinct, so the values match the dense dy exactly.
+static int lora_build_sparse_dy(
+  int* idx_out,
+  float* vals_out,
+  const float* probs,
+  int out_dim,
+  int target_id,
+  float push,
+  float pull,
+  int topk
+) {
+  int m = 0;
+  idx_out[m] = target_id; vals_out[m] = push; m++;
+
+  if (topk <= 0) {
+    int comp = argmax_excluding(probs, out_dim, target_id);
+    if (comp >= 0) { idx_out[m] = comp; vals_out[m] = -pull; m++; }
+    return m;
+  }
+
+  int K = topk;
+  if (K > LORA_MAX_TOPK) K = LORA_MAX_TOPK;
+  int comp[LORA_MAX_TOPK];
+  topk_excluding(probs, out_dim, target_id, K, comp);
+
+  float each = pull / (float)K;
+  for (int k = 0; k < K; k++) {
+    if (comp[k] >= 0) { idx_out[m] = comp[k]; vals_out[m] = -each; m++; }
+  }
+  return m;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // Sparse Apply — for vocabulary-sized outputs
 // Only applies LoRA delta to selected output indices
@@ -378,35 +733,13 @@ void lora_build_dy_from_probs(
 
 void lora_apply_sparse(LoRA* L, const float* x, float* y, const int* idx, int m) {
   if (!L || !x || !y || !idx || m <= 0) return;
-
-  const float scaling = L->alpha / (float)L->rank;
-
-  // Ax = x^T * A  -> [rank]
-  for (int r = 0; r < L->rank; r++) {
-    float s = 0.0f;
-    for (int i = 0; i < L->in_dim; i++) {
-      s += x[i] * L->A[(size_t)i * (size_t)L->rank + (size_t)r];
-    }
-    L->Ax[r] = s;
-  }
-
-  // update only selected outputs
-  for (int t = 0; t < m; t++) {
-    int j = idx[t];
-    if (j < 0 || j >= L->out_dim) continue;
-
-    float s = 0.0f;
-    size_t col = (size_t)j;
-    for (int r = 0; r < L->rank; r++) {
-      s += L->Ax[r] * L->B[(size_t)r * (size_t)L->out_dim + col];
-    }
-    y[j] += s * scaling;
-  }
+  lora_apply_core(L, x, y, idx, m, L->alpha);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
 // Experience Step — one-call wrapper for notorch learning
-// Builds dy from probs internally, then applies notch_step
+// Builds a sparse dy from probs internally, then applies notch_step_sparse
+// (only the target and competitor columns of B are touched)
 // 
 // This is the "breathing" interface: 
 //   lung.forward() → probs
@@ -426,11 +759,13 @@ void lora_experience_step(
   if (!L || !x || !probs) return;
   if (target_id < 0 || target_id >= L->out_dim) return;
 
-  // Build dy from probs
-  lora_build_dy_from_probs(L->dy, probs, L->out_dim, target_id, push, pull, topk);
-  
-  // Apply notorch step
-  lora_notch_step(L, x, L->dy, signal);
+  // Sparse dy: target + at most LORA_MAX_TOPK competitors
+  int idx[1 + LORA_MAX_TOPK];
+  float vals[1 + LORA_MAX_TOPK];
+  int m = lora_build_sparse_dy(idx, vals, probs, L->out_dim, target_id, push, pull, topk);
+
+  // Apply notorch step on the touched columns only
+  lora_notch_step_sparse(L, x, idx, vals, m, signal);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -439,15 +774,8 @@ void lora_experience_step(
 
 float lora_get_delta_norm(const LoRA* L) {
   if (!L) return 0.0f;
-  
-  float sum = 0.0f;
-  const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
-  const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
-  
-  for (size_t i = 0; i < nA; i++) sum += L->A[i] * L->A[i];
-  for (size_t i = 0; i < nB; i++) sum += L->B[i] * L->B[i];
-  
-  return sqrtf(sum);
+  lora_norms_sync(L);
+  return fabsf(L->fscale) * (float)sqrt(L->sqA + L->sqB);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -472,7 +800,11 @@ int lora_copy_params(const LoRA* L, float* out7) {
 
 // Get raw pointers to A and B for WASM direct memory access
 // Useful for JS-side visualization or bulk operations
-void lora_get_factor_ptrs(const LoRA* L, float** A_out, float** B_out, int* nA_out, int* nB_out) {
+// Layout: A is rank×in_dim (A[r*in_dim + i]), B is out_dim×rank (B[j*rank + r]).
+// The lazy scale is folded in first, so the pointed-to values are the true
+// factors at the time of the call; later decay/scale steps go back to fscale
+// (see lora_get_factor_scale).
+void lora_get_factor_ptrs(LoRA* L, float** A_out, float** B_out, int* nA_out, int* nB_out) {
   if (!L) {
     if (A_out) *A_out = NULL;
     if (B_out) *B_out = NULL;
@@ -480,12 +812,20 @@ void lora_get_factor_ptrs(const LoRA* L, float** A_out, float** B_out, int* nA_o
     if (nB_out) *nB_out = 0;
     return;
   }
+  lora_fold_scale(L);
+  L->dirty = 1;  // the caller may write through the pointers
+  L->norm_stale = 1;
   if (A_out) *A_out = L->A;
   if (B_out) *B_out = L->B;
   if (nA_out) *nA_out = L->in_dim * L->rank;
   if (nB_out) *nB_out = L->rank * L->out_dim;
 }
 
+// Current lazy factor scale: true A/B = scale · stored A/B
+float lora_get_factor_scale(const LoRA* L) {
+  return L ? L->fscale : 0.0f;
+}
+
 // Set seed for deterministic testing
 void lora_set_seed(LoRA* L, uint32_t seed) {
   if (L) L->seed = seed ? seed : 0xA17A11u;
@@ -510,16 +850,9 @@ void lora_get_factor_norms(const LoRA* L, float* normA_out, float* normB_out) {
     if (normB_out) *normB_out = 0.0f;
     return;
   }
-  
-  const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
-  const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
-  
-  float sumA = 0.0f, sumB = 0.0f;
-  for (size_t i = 0; i < nA; i++) sumA += L->A[i] * L->A[i];
-  for (size_t i = 0; i < nB; i++) sumB += L->B[i] * L->B[i];
-  
-  if (normA_out) *normA_out = sqrtf(sumA);
-  if (normB_out) *normB_out = sqrtf(sumB);
+  lora_norms_sync(L);
+  if (normA_out) *normA_out = fabsf(L->fscale) * (float)sqrt(L->sqA);
+  if (normB_out) *normB_out = fabsf(L->fscale) * (float)sqrt(L->sqB);
 }
 
 // Soft reset: scale down factors instead of zeroing (gradual forgetting)
@@ -532,26 +865,1221 @@ void lora_soft_reset(LoRA* L, float keep_ratio) {
 // Apply with custom alpha (for interpolation/blending)
 void lora_apply_alpha(LoRA* L, const float* x, float* y, float custom_alpha) {
   if (!L || !x || !y) return;
+  lora_apply_core(L, x, y, NULL, 0, custom_alpha);
+}
 
-  const float scaling = custom_alpha / (float)L->rank;
+// ═══════════════════════════════════════════════════════════════════════════════
+// Fold / Unfold — bake the delta into a base weight matrix
+//
+// lora_fold_into(L, W, layout, ld) adds (alpha/rank)·fscale²·A·B into W, so
+// the base projection alone gives the adapted output and lora_apply can be
+// skipped. W is in_dim × out_dim in the given layout with leading dimension
+// ld (0 = dense). For AriannaLung's Wo:
+//   lung_weights_retain(lung_get_weights(lung));  // pin Wo: growth refuses
+//   lora_fold_into(L, lung_get_output_weights(lung), LORA_LAYOUT_IN_OUT,
+//                  lung_get_output_stride(lung));
+//   lung_touch(lung);   // Wo changed: drop the top-k index
+//   ...
+//   lora_unfold_from(L, W, LORA_LAYOUT_IN_OUT); lung_touch(lung);
+//   lung_weights_release(lung_get_weights(lung));
+//
+// L keeps W until it is unfolded. lung_reserve_vocab / lung_grow_vocab move
+// Wo to a new block and free the old one, so W must not be reallocated while
+// folded: the extra weights reference makes them return 0 instead. Wo
+// belongs to the shared weights, so the fold is seen by every session on
+// them, not only the one it was taken from.
+//
+// The touched region is snapshotted first, so lora_unfold_from restores W
+// bit-exactly (subtracting the delta again would not, in float). Learning may
+// keep running on the factors while folded; it sets the dirty flag, and
+// lora_refold re-bakes the current delta over the snapshot.
+// Only one fold per adapter at a time. Returns 0 on success, 1 on error.
+// ═══════════════════════════════════════════════════════════════════════════════
 
-  // Ax = x^T * A  -> [rank]
-  for (int r = 0; r < L->rank; r++) {
-    float s = 0.0f;
-    for (int i = 0; i < L->in_dim; i++) {
-      s += x[i] * L->A[(size_t)i * (size_t)L->rank + (size_t)r];
+// W region = snapshot, then W += delta
+static void lora_fold_write(LoRA* L) {
+  const int in_dim = L->in_dim, out_dim = L->out_dim, rank = L->rank;
+  const float scaling = L->alpha / (float)rank * L->fscale * L->fscale;
+  float* W = L->fold_W;
+  const float* snap = L->fold_snap;
+
+  if (L->fold_layout == LORA_LAYOUT_IN_OUT) {
+    // row i of W += (scaling·A[:, i]) · B^T — the lora_apply out kernel
+    for (int i = 0; i < in_dim; i++) {
+      float* w = W + (size_t)i * (size_t)L->fold_ld;
+      memcpy(w, snap + (size_t)i * (size_t)out_dim, (size_t)out_dim * sizeof(float));
+      for (int r = 0; r < rank; r++) L->Ax[r] = L->A[(size_t)r * (size_t)in_dim + (size_t)i] * scaling;
+      L->out_kernel(L->B, L->Ax, w, NULL, 0, out_dim, rank);
+    }
+  } else {
+    // row j of W += Σ_r (scaling·B[j, r]) · A[r]
+    for (int j = 0; j < out_dim; j++) {
+      float* restrict w = W + (size_t)j * (size_t)L->fold_ld;
+      memcpy(w, snap + (size_t)j * (size_t)in_dim, (size_t)in_dim * sizeof(float));
+      const float* b = L->B + (size_t)j * (size_t)rank;
+      for (int r = 0; r < rank; r++) {
+        const float* restrict a = L->A + (size_t)r * (size_t)in_dim;
+        float c = b[r] * scaling;
+        for (int i = 0; i < in_dim; i++) w[i] += c * a[i];
+      }
     }
-    L->Ax[r] = s;
   }
+  L->dirty = 0;
+}
 
-  // add scaled output
-  for (int j = 0; j < L->out_dim; j++) {
-    float s = 0.0f;
-    for (int r = 0; r < L->rank; r++) {
-      s += L->Ax[r] * L->B[(size_t)r * (size_t)L->out_dim + (size_t)j];
+int lora_fold_into(LoRA* L, float* W, int layout, int ld) {
+  if (!L || !W || L->fold_W) return 1;
+  if (layout != LORA_LAYOUT_IN_OUT && layout != LORA_LAYOUT_OUT_IN) return 1;
+  int row = layout == LORA_LAYOUT_IN_OUT ? L->out_dim : L->in_dim;
+  if (ld == 0) ld = row;
+  if (ld < row) return 1;
+
+  float* snap = fcalloc((size_t)L->in_dim * (size_t)L->out_dim);
+  if (!snap) return 1;
+  L->fold_W = W;
+  L->fold_snap = snap;
+  L->fold_layout = layout;
+  L->fold_ld = ld;
+
+  // snapshot stored dense in the same orientation
+  int rows = layout == LORA_LAYOUT_IN_OUT ? L->in_dim : L->out_dim;
+  for (int k = 0; k < rows; k++) {
+    memcpy(snap + (size_t)k * (size_t)row, W + (size_t)k * (size_t)ld, (size_t)row * sizeof(float));
+  }
+  lora_fold_write(L);
+  return 0;
+}
+
+// Restore W exactly; W must be the matrix passed to lora_fold_into
+int lora_unfold_from(LoRA* L, float* W, int layout) {
+  if (!L || !L->fold_W || W != L->fold_W || layout != L->fold_layout) return 1;
+  int row = layout == LORA_LAYOUT_IN_OUT ? L->out_dim : L->in_dim;
+  int rows = layout == LORA_LAYOUT_IN_OUT ? L->in_dim : L->out_dim;
+  for (int k = 0; k < rows; k++) {
+    memcpy(W + (size_t)k * (size_t)L->fold_ld, L->fold_snap + (size_t)k * (size_t)row, (size_t)row * sizeof(float));
+  }
+  free(L->fold_snap);
+  L->fold_snap = NULL;
+  L->fold_W = NULL;
+  L->dirty = 1;
+  return 0;
+}
+
+// Re-bake the current factors into the folded W (no-op when clean)
+int lora_refold(LoRA* L) {
+  if (!L || !L->fold_W) return 1;
+  if (L->dirty) lora_fold_write(L);
+  return 0;
+}
+
+int lora_is_folded(const LoRA* L) { return L && L->fold_W ? 1 : 0; }
+int lora_is_dirty(const LoRA* L) { return L ? L->dirty : 0; }
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Experience Shards — persistent adapters + append-only experience log
+//
+// One file per adapter (weights/shards/{timestamp}_{context_hash}.shard),
+// host byte order (little-endian on every supported target — a shard from a
+// big-endian host fails the magic check), every section 64-byte aligned:
+//
+//   [0, 64)          LoRAShardHeader (magic "LRSH", version, dims, hparams)
+//   factors_offset   A (rank×in_dim) then B (out_dim×rank), float32, stored
+//                    exactly as in memory (lazily scaled by fscale)
+//   log_offset       records of record_bytes each, until end of file:
+//                      uint32 seed     RNG state before the step
+//                      int32  m        number of (idx, val) pairs used,
+//                                      or -1 for a scale record
+//                      float  signal   (scale records: the factor)
+//                      int32  idx[LORA_SHARD_PAIRS]
+//                      float  val[LORA_SHARD_PAIRS]
+//                      float  x[in_dim]
+//
+// The record count is implied by the file size, so appending is a plain
+// write at the end (a torn last record is ignored). lora_scale (and so
+// lora_clamp_factors and lora_soft_reset) logs the factor it applied as a
+// scale record. Because each step record carries its RNG seed, replaying a
+// log over the factors it started from reproduces the trained adapter bit
+// for bit — as long as only logged operations touched it in between:
+// dense lora_notch_step, lora_merge, lora_reset and lora_compact are not
+// logged.
+//
+// lora_load_mmap maps the file copy-on-write: A and B point into the
+// mapping (no copy, no parse), and further learning never writes the file.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LORA_SHARD_MAGIC   0x4853524Cu  // "LRSH"
+#define LORA_SHARD_VERSION 1u
+#define LORA_SHARD_ALIGN   64
+#define LORA_SHARD_PAIRS   (1 + LORA_MAX_TOPK)  // target + competitors
+#define LORA_SHARD_SCALE   (-1)                  // record m: lora_scale(signal)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  int32_t in_dim;
+  int32_t out_dim;
+  int32_t rank;
+  float alpha;
+  float lr;
+  float decay;
+  float fscale;
+  uint32_t seed;
+  uint64_t factors_offset;
+  uint64_t log_offset;
+  uint32_t record_bytes;
+  uint32_t pairs;
+} LoRAShardHeader;
+
+typedef char lora_shard_header_is_64_bytes[sizeof(LoRAShardHeader) == LORA_SHARD_ALIGN ? 1 : -1];
+
+static size_t lora_shard_align(size_t n) {
+  return (n + LORA_SHARD_ALIGN - 1) & ~(size_t)(LORA_SHARD_ALIGN - 1);
+}
+
+static size_t lora_shard_record_bytes(int in_dim) {
+  return 12 + (size_t)LORA_SHARD_PAIRS * 8 + (size_t)in_dim * sizeof(float);
+}
+
+static void lora_shard_header(const LoRA* L, LoRAShardHeader* h) {
+  size_t nA = (size_t)L->in_dim * (size_t)L->rank;
+  size_t nB = (size_t)L->rank * (size_t)L->out_dim;
+  memset(h, 0, sizeof(*h));
+  h->magic = LORA_SHARD_MAGIC;
+  h->version = LORA_SHARD_VERSION;
+  h->in_dim = L->in_dim;
+  h->out_dim = L->out_dim;
+  h->rank = L->rank;
+  h->alpha = L->alpha;
+  h->lr = L->lr;
+  h->decay = L->decay;
+  h->fscale = L->fscale;
+  h->seed = L->seed;
+  h->factors_offset = LORA_SHARD_ALIGN;
+  h->log_offset = lora_shard_align(LORA_SHARD_ALIGN + (nA + nB) * sizeof(float));
+  h->record_bytes = (uint32_t)lora_shard_record_bytes(L->in_dim);
+  h->pairs = LORA_SHARD_PAIRS;
+}
+
+static int lora_shard_check(const LoRAShardHeader* h, size_t file_bytes) {
+  if (h->magic != LORA_SHARD_MAGIC || h->version != LORA_SHARD_VERSION) return 1;
+  if (h->in_dim <= 0 || h->out_dim <= 0 || h->rank <= 0) return 1;
+  if (h->pairs != LORA_SHARD_PAIRS || h->record_bytes != lora_shard_record_bytes(h->in_dim)) return 1;
+  size_t nA = (size_t)h->in_dim * (size_t)h->rank;
+  size_t nB = (size_t)h->rank * (size_t)h->out_dim;
+  if (h->factors_offset != LORA_SHARD_ALIGN) return 1;
+  if (h->log_offset != lora_shard_align(LORA_SHARD_ALIGN + (nA + nB) * sizeof(float))) return 1;
+  if (file_bytes < h->log_offset) return 1;
+  return 0;
+}
+
+static int lora_write_zeros(FILE* f, size_t n) {
+  static const char zero[LORA_SHARD_ALIGN] = {0};
+  while (n > 0) {
+    size_t k = n < sizeof(zero) ? n : sizeof(zero);
+    if (fwrite(zero, 1, k, f) != k) return 1;
+    n -= k;
+  }
+  return 0;
+}
+
+// Write header + factors with an empty log. Goes through path.tmp + rename,
+// so a shard that is currently mapped keeps its old contents.
+int lora_save(const LoRA* L, const char* path) {
+  if (!L || !path) return 1;
+  LoRAShardHeader h;
+  lora_shard_header(L, &h);
+  size_t nA = (size_t)L->in_dim * (size_t)L->rank;
+  size_t nB = (size_t)L->rank * (size_t)L->out_dim;
+
+  size_t plen = strlen(path);
+  char* tmp = (char*)malloc(plen + 5);
+  if (!tmp) return 1;
+  memcpy(tmp, path, plen);
+  memcpy(tmp + plen, ".tmp", 5);
+
+  FILE* f = fopen(tmp, "wb");
+  int err = !f;
+  if (!err) {
+    err |= fwrite(&h, sizeof(h), 1, f) != 1;
+    err |= fwrite(L->A, sizeof(float), nA, f) != nA;
+    err |= fwrite(L->B, sizeof(float), nB, f) != nB;
+    err |= lora_write_zeros(f, (size_t)h.log_offset - LORA_SHARD_ALIGN - (nA + nB) * sizeof(float));
+    err |= fclose(f) != 0;
+  }
+  if (!err) err = rename(tmp, path) != 0;
+  if (err) remove(tmp);
+  free(tmp);
+  return err;
+}
+
+static void lora_unmap(LoRA* L) {
+#ifdef LORA_HAVE_MMAP
+  if (!L->map_heap) { munmap(L->map, L->map_bytes); L->map = NULL; return; }
+#endif
+  free(L->map);
+  L->map = NULL;
+}
+
+static void* lora_map_file(FILE* f, size_t bytes, int* heap_out) {
+  *heap_out = 0;
+#ifdef LORA_HAVE_MMAP
+  void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+  if (p != MAP_FAILED) return p;
+#endif
+  // no mmap: one read into the heap
+  void* buf = malloc(bytes);
+  if (!buf) return NULL;
+  if (fseek(f, 0, SEEK_SET) != 0 || fread(buf, 1, bytes, f) != bytes) { free(buf); return NULL; }
+  *heap_out = 1;
+  return buf;
+}
+
+static size_t lora_file_size(FILE* f) {
+  if (fseek(f, 0, SEEK_END) != 0) return 0;
+  long n = ftell(f);
+  return n > 0 ? (size_t)n : 0;
+}
+
+// Restore an adapter from a shard: factors are mapped, not copied or
+// replayed. The log is left alone (see lora_replay).
+LoRA* lora_load_mmap(const char* path) {
+  if (!path) return NULL;
+  FILE* f = fopen(path, "rb");
+  if (!f) return NULL;
+  size_t bytes = lora_file_size(f);
+  LoRAShardHeader h;
+  if (bytes < sizeof(h) || fseek(f, 0, SEEK_SET) != 0 || fread(&h, sizeof(h), 1, f) != 1 ||
+      lora_shard_check(&h, bytes)) {
+    fclose(f);
+    return NULL;
+  }
+
+  LoRA* L = (LoRA*)calloc(1, sizeof(LoRA));
+  if (!L) { fclose(f); return NULL; }
+  L->map = lora_map_file(f, bytes, &L->map_heap);
+  fclose(f);  // the mapping outlives the descriptor
+  if (!L->map) { free(L); return NULL; }
+  L->map_bytes = bytes;
+
+  L->in_dim = h.in_dim;
+  L->out_dim = h.out_dim;
+  L->rank = h.rank;
+  L->alpha = h.alpha;
+  L->lr = h.lr;
+  L->decay = h.decay;
+  L->fscale = h.fscale;
+  L->seed = h.seed;
+  L->A = (float*)((char*)L->map + h.factors_offset);
+  L->B = L->A + (size_t)h.in_dim * (size_t)h.rank;
+
+  L->u = fcalloc((size_t)L->rank);
+  L->dy = fcalloc((size_t)L->out_dim);
+  L->Ax = fcalloc((size_t)L->rank);
+  L->XA = fcalloc((size_t)LORA_BATCH_ROWS * (size_t)L->rank);
+  if (!L->u || !L->dy || !L->Ax || !L->XA) { lora_free(L); return NULL; }
+
+  lora_pick_kernel(L);
+  L->norm_stale = 1;
+  return L;
+}
+
+static int lora_shard_open(const char* path, const char* mode, LoRAShardHeader* h, size_t* bytes_out, FILE** f_out) {
+  FILE* f = fopen(path, mode);
+  if (!f) return 1;
+  size_t bytes = lora_file_size(f);
+  if (bytes < sizeof(*h) || fseek(f, 0, SEEK_SET) != 0 || fread(h, sizeof(*h), 1, f) != 1 ||
+      lora_shard_check(h, bytes)) {
+    fclose(f);
+    return 1;
+  }
+  *bytes_out = bytes;
+  *f_out = f;
+  return 0;
+}
+
+// Start appending every sparse notch step of L (incl. lora_experience_step)
+// and every lora_scale / lora_clamp_factors / lora_soft_reset to the shard's
+// log; path = NULL stops. Steps with more than LORA_SHARD_PAIRS (idx, val)
+// pairs, dense lora_notch_step calls, lora_merge, lora_reset and
+// lora_compact are not logged, so a replay is exact only over a session
+// that used none of them. The shard must match L's dims.
+int lora_shard_record(LoRA* L, const char* path) {
+  if (!L) return 1;
+  if (L->log) { fclose(L->log); L->log = NULL; }
+  if (!path) return 0;
+
+  LoRAShardHeader h;
+  size_t bytes;
+  FILE* f;
+  if (lora_shard_open(path, "r+b", &h, &bytes, &f)) return 1;
+  if (h.in_dim != L->in_dim || h.out_dim != L->out_dim || h.rank != L->rank) { fclose(f); return 1; }
+
+  // drop a torn tail so records stay on record_bytes boundaries
+  size_t whole = (bytes - (size_t)h.log_offset) / h.record_bytes;
+  if (fseek(f, (long)(h.log_offset + whole * h.record_bytes), SEEK_SET) != 0) { fclose(f); return 1; }
+  L->log = f;
+  return 0;
+}
+
+// x may be NULL for scale records (written as zeros)
+static void lora_log_record(LoRA* L, uint32_t seed, const float* x, const int* idx, const float* vals, int m, float signal) {
+  if (m < LORA_SHARD_SCALE || m > LORA_SHARD_PAIRS) return;
+  uint32_t head[2] = { seed, (uint32_t)m };
+  int32_t ri[LORA_SHARD_PAIRS];
+  float rv[LORA_SHARD_PAIRS];
+  for (int t = 0; t < LORA_SHARD_PAIRS; t++) {
+    ri[t] = t < m ? idx[t] : -1;
+    rv[t] = t < m ? vals[t] : 0.0f;
+  }
+  fwrite(head, sizeof(head), 1, L->log);
+  fwrite(&signal, sizeof(float), 1, L->log);
+  fwrite(ri, sizeof(ri), 1, L->log);
+  fwrite(rv, sizeof(rv), 1, L->log);
+  if (x) {
+    fwrite(x, sizeof(float), (size_t)L->in_dim, L->log);
+  } else {
+    const float zero = 0.0f;
+    for (int i = 0; i < L->in_dim; i++) fwrite(&zero, sizeof(float), 1, L->log);
+  }
+  fflush(L->log);
+}
+
+// Number of complete experience records in a shard, -1 if unreadable
+int lora_shard_log_count(const char* path) {
+  LoRAShardHeader h;
+  size_t bytes;
+  FILE* f;
+  if (!path || lora_shard_open(path, "rb", &h, &bytes, &f)) return -1;
+  fclose(f);
+  return (int)((bytes - (size_t)h.log_offset) / h.record_bytes);
+}
+
+// Re-run records [from, from+count) of a shard's log through
+// lora_notch_step_sparse, or lora_scale for scale records (count < 0: to the
+// end). Each record restores its RNG seed first. Returns the number of
+// records applied, -1 on error.
+int lora_replay(LoRA* L, const char* path, int from, int count) {
+  if (!L || !path || from < 0) return -1;
+  LoRAShardHeader h;
+  size_t bytes;
+  FILE* f;
+  if (lora_shard_open(path, "rb", &h, &bytes, &f)) return -1;
+  if (h.in_dim != L->in_dim || h.out_dim != L->out_dim) { fclose(f); return -1; }
+
+  int total = (int)((bytes - (size_t)h.log_offset) / h.record_bytes);
+  int end = (count < 0 || from + count > total) ? total : from + count;
+  if (from >= end) { fclose(f); return 0; }
+
+  unsigned char* rec = (unsigned char*)malloc(h.record_bytes);
+  if (!rec) { fclose(f); return -1; }
+  if (fseek(f, (long)(h.log_offset + (size_t)from * h.record_bytes), SEEK_SET) != 0) {
+    free(rec); fclose(f); return -1;
+  }
+
+  // replayed steps are not re-logged
+  FILE* log = L->log;
+  L->log = NULL;
+  int done = 0;
+  for (int k = from; k < end; k++) {
+    if (fread(rec, 1, h.record_bytes, f) != h.record_bytes) break;
+    uint32_t head[2];
+    float signal;
+    int32_t ri[LORA_SHARD_PAIRS];
+    float rv[LORA_SHARD_PAIRS];
+    memcpy(head, rec, 8);
+    memcpy(&signal, rec + 8, 4);
+    memcpy(ri, rec + 12, sizeof(ri));
+    memcpy(rv, rec + 12 + sizeof(ri), sizeof(rv));
+    const float* x = (const float*)(rec + 12 + sizeof(ri) + sizeof(rv));  // 4-aligned
+    int m = (int)head[1];
+    if (m < LORA_SHARD_SCALE || m > LORA_SHARD_PAIRS) break;
+    L->seed = head[0];
+    if (m == LORA_SHARD_SCALE) {
+      lora_rescale(L, signal);
+    } else {
+      int idx[LORA_SHARD_PAIRS];
+      for (int t = 0; t < m; t++) idx[t] = ri[t];
+      lora_notch_step_sparse(L, x, idx, rv, m, signal);
+    }
+    done++;
+  }
+  L->log = log;
+
+  free(rec);
+  fclose(f);
+  return done;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Background Learner — experience queue → notch steps → published snapshots
+//
+// Inference threads must not pay for learning. The learner owns one adapter
+// (the master) and trains it off the hot path:
+//
+//   producer (inference)             learner                  readers
+//   lora_learner_push ──► SPSC ring ──► lora_notch_step_sparse
+//                                       every publish_every steps:
+//                                       copy master → back buffer ──► acquire
+//
+// The ring is single-producer/single-consumer and lock-free: head and tail
+// are __atomic counters, records are fixed size (x, target + top-k as
+// sparse dy, signal). A full ring drops the experience (counted), never
+// blocks the producer.
+//
+// Publication is a triple buffer: the learner fills its back snapshot and
+// swaps it with the middle one in a single atomic exchange; a reader's
+// acquire swaps the middle one into its front only if it is newer. The
+// (single) reader never waits on the learner and keeps its snapshot until
+// the next acquire. Each publish bumps the epoch.
+//
+// With -DLORA_THREADS a worker thread drains the ring (it sleeps when empty;
+// the producer only takes a lock to wake it). Without it, push runs the step
+// synchronously — same API, no threads. While the learner exists the master
+// adapter belongs to it; call lora_learner_free before touching it again.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LORA_LEARNER_PAIRS (1 + LORA_MAX_TOPK)
+#define LORA_LEARNER_FRESH 4  // set in 'middle' when it holds an unread publish
+
+typedef struct {
+  LoRA* master;
+  LoRA* snap[3];          // published copies
+  int epoch_of[3];
+  int back;               // learner's snapshot being filled
+  int middle;             // index | LORA_LEARNER_FRESH (atomic)
+  int front;              // reader's snapshot
+  int epoch;              // publishes so far
+  int publish_every;
+  int since_publish;
+
+  // SPSC ring of experiences
+  int cap;                // power of two
+  unsigned head;          // next slot to write (producer, atomic)
+  unsigned tail;          // next slot to read (consumer, atomic)
+  int* r_m;
+  float* r_signal;
+  int* r_idx;             // cap × LORA_LEARNER_PAIRS
+  float* r_vals;          // cap × LORA_LEARNER_PAIRS
+  float* r_x;             // cap × in_dim
+
+  int steps;              // experiences applied (atomic)
+  int dropped;            // pushed into a full ring (producer only)
+
+#ifdef LORA_THREADS
+  pthread_t thread;
+  pthread_mutex_t mu;
+  pthread_cond_t wake;
+  pthread_cond_t idle;
+  int sleeping;           // worker is (about to be) waiting on wake (atomic)
+  int busy;               // worker is between taking and finishing a batch
+  int quit;
+#endif
+} LoRALearner;
+
+static void lora_copy_factors(LoRA* dst, const LoRA* src) {
+  memcpy(dst->A, src->A, (size_t)src->in_dim * (size_t)src->rank * sizeof(float));
+  memcpy(dst->B, src->B, (size_t)src->rank * (size_t)src->out_dim * sizeof(float));
+  dst->fscale = src->fscale;
+  dst->alpha = src->alpha;
+  dst->lr = src->lr;
+  dst->decay = src->decay;
+  dst->seed = src->seed;
+  dst->dirty = 1;
+  dst->sqA = src->sqA;
+  dst->sqB = src->sqB;
+  dst->norm_updates = src->norm_updates;
+  dst->norm_stale = src->norm_stale;
+}
+
+// learner side: fill back, hand it over as the new middle
+static void lora_learner_publish(LoRALearner* Ln) {
+  lora_copy_factors(Ln->snap[Ln->back], Ln->master);
+  Ln->epoch_of[Ln->back] = ++Ln->epoch;
+  int old = __atomic_exchange_n(&Ln->middle, Ln->back | LORA_LEARNER_FRESH, __ATOMIC_ACQ_REL);
+  Ln->back = old & ~LORA_LEARNER_FRESH;
+  Ln->since_publish = 0;
+}
+
+// learner side: apply every queued experience; returns how many
+static int lora_learner_drain(LoRALearner* Ln) {
+  unsigned tail = Ln->tail;
+  unsigned head = __atomic_load_n(&Ln->head, __ATOMIC_ACQUIRE);
+  const int in_dim = Ln->master->in_dim;
+  int n = 0;
+  while (tail != head) {
+    unsigned k = tail & (unsigned)(Ln->cap - 1);
+    lora_notch_step_sparse(Ln->master, Ln->r_x + (size_t)k * (size_t)in_dim,
+                           Ln->r_idx + (size_t)k * LORA_LEARNER_PAIRS,
+                           Ln->r_vals + (size_t)k * LORA_LEARNER_PAIRS,
+                           Ln->r_m[k], Ln->r_signal[k]);
+    tail++;
+    __atomic_store_n(&Ln->tail, tail, __ATOMIC_RELEASE);  // slot free for the producer
+    __atomic_add_fetch(&Ln->steps, 1, __ATOMIC_RELAXED);
+    n++;
+    if (++Ln->since_publish >= Ln->publish_every) lora_learner_publish(Ln);
+    if (tail == head) head = __atomic_load_n(&Ln->head, __ATOMIC_ACQUIRE);
+  }
+  return n;
+}
+
+#ifdef LORA_THREADS
+static void* lora_learner_worker(void* arg) {
+  LoRALearner* Ln = (LoRALearner*)arg;
+  pthread_mutex_lock(&Ln->mu);
+  for (;;) {
+    // announce sleep first, then re-check the ring (pairs with push)
+    __atomic_store_n(&Ln->sleeping, 1, __ATOMIC_SEQ_CST);
+    while (!Ln->quit && __atomic_load_n(&Ln->head, __ATOMIC_SEQ_CST) == Ln->tail) {
+      pthread_cond_broadcast(&Ln->idle);
+      pthread_cond_wait(&Ln->wake, &Ln->mu);
+    }
+    __atomic_store_n(&Ln->sleeping, 0, __ATOMIC_SEQ_CST);
+    if (Ln->quit) break;
+    Ln->busy = 1;
+    pthread_mutex_unlock(&Ln->mu);
+
+    lora_learner_drain(Ln);
+
+    pthread_mutex_lock(&Ln->mu);
+    Ln->busy = 0;
+  }
+  pthread_mutex_unlock(&Ln->mu);
+  return NULL;
+}
+#endif
+
+static void lora_learner_release(LoRALearner* Ln) {
+  for (int i = 0; i < 3; i++) lora_free(Ln->snap[i]);
+  free(Ln->r_m); free(Ln->r_signal); free(Ln->r_idx); free(Ln->r_vals); free(Ln->r_x);
+  free(Ln);
+}
+
+// capacity: ring slots (rounded up to a power of two); publish_every:
+// experiences between snapshots (>= 1)
+LoRALearner* lora_learner_new(LoRA* L, int capacity, int publish_every) {
+  if (!L || capacity <= 0) return NULL;
+  LoRALearner* Ln = (LoRALearner*)calloc(1, sizeof(LoRALearner));
+  if (!Ln) return NULL;
+  Ln->master = L;
+  Ln->publish_every = publish_every < 1 ? 1 : publish_every;
+  Ln->cap = 1;
+  while (Ln->cap < capacity) Ln->cap <<= 1;
+
+  size_t cap = (size_t)Ln->cap;
+  Ln->r_m = (int*)calloc(cap, sizeof(int));
+  Ln->r_signal = fcalloc(cap);
+  Ln->r_idx = (int*)calloc(cap * LORA_LEARNER_PAIRS, sizeof(int));
+  Ln->r_vals = fcalloc(cap * LORA_LEARNER_PAIRS);
+  Ln->r_x = fcalloc(cap * (size_t)L->in_dim);
+  int ok = Ln->r_m && Ln->r_signal && Ln->r_idx && Ln->r_vals && Ln->r_x;
+  for (int i = 0; i < 3 && ok; i++) {
+    Ln->snap[i] = lora_new(L->in_dim, L->out_dim, L->rank, L->alpha, L->lr, L->decay, 1);
+    ok = Ln->snap[i] != NULL;
+    if (ok) lora_copy_factors(Ln->snap[i], L);
+  }
+  if (!ok) { lora_learner_release(Ln); return NULL; }
+
+  // epoch 0: all three hold the starting factors, reader on 0
+  Ln->front = 0;
+  Ln->middle = 1;
+  Ln->back = 2;
+
+#ifdef LORA_THREADS
+  pthread_mutex_init(&Ln->mu, NULL);
+  pthread_cond_init(&Ln->wake, NULL);
+  pthread_cond_init(&Ln->idle, NULL);
+  if (pthread_create(&Ln->thread, NULL, lora_learner_worker, Ln) != 0) {
+    pthread_mutex_destroy(&Ln->mu);
+    pthread_cond_destroy(&Ln->wake);
+    pthread_cond_destroy(&Ln->idle);
+    lora_learner_release(Ln);
+    return NULL;
+  }
+#endif
+  return Ln;
+}
+
+// Queue one experience with dy as (idx, vals) pairs (m <= 1 + LORA_MAX_TOPK).
+// Returns 1 if queued, 0 if dropped (ring full or bad input).
+int lora_learner_push_sparse(LoRALearner* Ln, const float* x, const int* idx, const float* vals, int m, float signal) {
+  if (!Ln || !x || m < 0 || m > LORA_LEARNER_PAIRS || (m > 0 && (!idx || !vals))) return 0;
+  unsigned head = Ln->head;
+  unsigned tail = __atomic_load_n(&Ln->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= (unsigned)Ln->cap) { Ln->dropped++; return 0; }
+
+  unsigned k = head & (unsigned)(Ln->cap - 1);
+  const int in_dim = Ln->master->in_dim;
+  memcpy(Ln->r_x + (size_t)k * (size_t)in_dim, x, (size_t)in_dim * sizeof(float));
+  if (m > 0) {
+    memcpy(Ln->r_idx + (size_t)k * LORA_LEARNER_PAIRS, idx, (size_t)m * sizeof(int));
+    memcpy(Ln->r_vals + (size_t)k * LORA_LEARNER_PAIRS, vals, (size_t)m * sizeof(float));
+  }
+  Ln->r_m[k] = m;
+  Ln->r_signal[k] = signal;
+
+#ifdef LORA_THREADS
+  __atomic_store_n(&Ln->head, head + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&Ln->sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&Ln->mu);
+    pthread_cond_signal(&Ln->wake);
+    pthread_mutex_unlock(&Ln->mu);
+  }
+#else
+  __atomic_store_n(&Ln->head, head + 1, __ATOMIC_RELEASE);
+  lora_learner_drain(Ln);
+#endif
+  return 1;
+}
+
+// Same dy as lora_experience_step, built on the producer side (O(topk·out_dim))
+int lora_learner_push(LoRALearner* Ln, const float* x, const float* probs, int target_id,
+                      float signal, float push, float pull, int topk) {
+  if (!Ln || !x || !probs) return 0;
+  if (target_id < 0 || target_id >= Ln->master->out_dim) return 0;
+  int idx[LORA_LEARNER_PAIRS];
+  float vals[LORA_LEARNER_PAIRS];
+  int m = lora_build_sparse_dy(idx, vals, probs, Ln->master->out_dim, target_id, push, pull, topk);
+  return lora_learner_push_sparse(Ln, x, idx, vals, m, signal);
+}
+
+// Reader: switch to the newest published snapshot (if any newer) and return
+// it. Valid until the next acquire; use it like any adapter (lora_apply...).
+LoRA* lora_learner_acquire(LoRALearner* Ln) {
+  if (!Ln) return NULL;
+  if (__atomic_load_n(&Ln->middle, __ATOMIC_ACQUIRE) & LORA_LEARNER_FRESH) {
+    int old = __atomic_exchange_n(&Ln->middle, Ln->front, __ATOMIC_ACQ_REL);
+    Ln->front = old & ~LORA_LEARNER_FRESH;
+  }
+  return Ln->snap[Ln->front];
+}
+
+// Epoch of the reader's current snapshot (0 = starting factors)
+int lora_learner_epoch(const LoRALearner* Ln) {
+  return Ln ? Ln->epoch_of[Ln->front] : 0;
+}
+
+// Block until every queued experience is applied, then publish the result
+// (called from the producer side)
+void lora_learner_flush(LoRALearner* Ln) {
+  if (!Ln) return;
+#ifdef LORA_THREADS
+  pthread_mutex_lock(&Ln->mu);
+  while (Ln->busy || __atomic_load_n(&Ln->head, __ATOMIC_ACQUIRE) != __atomic_load_n(&Ln->tail, __ATOMIC_ACQUIRE)) {
+    pthread_cond_signal(&Ln->wake);
+    pthread_cond_wait(&Ln->idle, &Ln->mu);
+  }
+  // worker is parked: safe to publish from here
+  if (Ln->since_publish > 0) lora_learner_publish(Ln);
+  pthread_mutex_unlock(&Ln->mu);
+#else
+  if (Ln->since_publish > 0) lora_learner_publish(Ln);
+#endif
+}
+
+int lora_learner_steps(const LoRALearner* Ln) {
+  return Ln ? __atomic_load_n(&Ln->steps, __ATOMIC_RELAXED) : 0;
+}
+
+int lora_learner_dropped(const LoRALearner* Ln) {
+  return Ln ? Ln->dropped : 0;
+}
+
+// Drain, stop the worker and free the snapshots. The master adapter is
+// returned to the caller with every queued experience applied.
+void lora_learner_free(LoRALearner* Ln) {
+  if (!Ln) return;
+  lora_learner_flush(Ln);
+#ifdef LORA_THREADS
+  pthread_mutex_lock(&Ln->mu);
+  Ln->quit = 1;
+  pthread_cond_signal(&Ln->wake);
+  pthread_mutex_unlock(&Ln->mu);
+  pthread_join(Ln->thread, NULL);
+  pthread_mutex_destroy(&Ln->mu);
+  pthread_cond_destroy(&Ln->wake);
+  pthread_cond_destroy(&Ln->idle);
+#endif
+  lora_learner_release(Ln);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Compaction — re-orthogonalize and shrink to the effective rank
+//
+// Notch steps add a random rank-channel u every time, so A and B drift into
+// redundant, badly conditioned directions while the delta itself often
+// lives in far fewer. lora_compact rewrites the same delta in SVD form:
+//
+//   A = Q_A R_A,  Bᵀ = Q_B R_B           (modified Gram-Schmidt, twice)
+//   R_A R_Bᵀ = U Σ Vᵀ                    (one-sided Jacobi, r×r, double)
+//   A' = Q_A U_k √Σ_k·f,  B' = √Σ_k·f V_kᵀ Q_Bᵀ
+//
+// with k the smallest rank whose singular values hold `energy` of Σσ², and
+// f absorbing fscale² and the alpha/rank → alpha/k change, so at energy = 1
+// the applied delta is unchanged up to round-off. The new factors have
+// orthogonal columns and equal norms. Costs O((in+out)·r²) — run it now and
+// then (e.g. every few hundred steps), not per step. A and B are
+// reallocated at rank k (a mapped adapter moves to the heap) and the rank
+// scratch shrinks with them, so pointers from lora_get_factor_ptrs go stale;
+// apply then costs O(k) per output. Re-add a pooled adapter afterwards
+// (lora_pool_add, same id) so the pool's byte count follows. Returns the new
+// rank, or the old one if nothing was done.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Orthonormalize the r vectors V[s*n .. +n) in place; R (r×r, upper) gets
+// V_old = Q·R column-wise. Zero/dependent vectors become zero rows of Q.
+static void lora_mgs(float* V, int n, int r, double* R) {
+  for (int k = 0; k < r * r; k++) R[k] = 0.0;
+  for (int s = 0; s < r; s++) {
+    float* q = V + (size_t)s * (size_t)n;
+    for (int pass = 0; pass < 2; pass++) {
+      for (int p = 0; p < s; p++) {
+        const float* qp = V + (size_t)p * (size_t)n;
+        double d = 0.0;
+        for (int i = 0; i < n; i++) d += (double)qp[i] * q[i];
+        R[p * r + s] += d;
+        for (int i = 0; i < n; i++) q[i] -= (float)d * qp[i];
+      }
+    }
+    double nn = 0.0;
+    for (int i = 0; i < n; i++) nn += (double)q[i] * q[i];
+    double nrm = sqrt(nn);
+    R[s * r + s] = nrm;
+    if (nrm > 1e-30) {
+      float inv = (float)(1.0 / nrm);
+      for (int i = 0; i < n; i++) q[i] *= inv;
+    } else {
+      R[s * r + s] = 0.0;
+      for (int i = 0; i < n; i++) q[i] = 0.0f;
+    }
+  }
+}
+
+// One-sided Jacobi: M (r×r, row-major) -> M = U·diag(sig)·Vᵀ, sig descending.
+// M is overwritten with U.
+static void lora_jacobi_svd(double* M, double* V, double* sig, int r) {
+  for (int i = 0; i < r * r; i++) V[i] = 0.0;
+  for (int i = 0; i < r; i++) V[i * r + i] = 1.0;
+
+  for (int sweep = 0; sweep < 60; sweep++) {
+    double off = 0.0;
+    for (int p = 0; p < r - 1; p++) {
+      for (int q = p + 1; q < r; q++) {
+        double a = 0.0, b = 0.0, g = 0.0;
+        for (int i = 0; i < r; i++) {
+          a += M[i * r + p] * M[i * r + p];
+          b += M[i * r + q] * M[i * r + q];
+          g += M[i * r + p] * M[i * r + q];
+        }
+        if (fabs(g) <= 1e-15 * sqrt(a * b) || g == 0.0) continue;
+        off = fmax(off, fabs(g) / sqrt(a * b));
+        double zeta = (b - a) / (2.0 * g);
+        double t = (zeta >= 0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+        double c = 1.0 / sqrt(1.0 + t * t), sn = c * t;
+        for (int i = 0; i < r; i++) {
+          double mp = M[i * r + p], mq = M[i * r + q];
+          M[i * r + p] = c * mp - sn * mq;
+          M[i * r + q] = sn * mp + c * mq;
+          double vp = V[i * r + p], vq = V[i * r + q];
+          V[i * r + p] = c * vp - sn * vq;
+          V[i * r + q] = sn * vp + c * vq;
+        }
+      }
+    }
+    if (off < 1e-15) break;
+  }
+
+  for (int j = 0; j < r; j++) {
+    double nn = 0.0;
+    for (int i = 0; i < r; i++) nn += M[i * r + j] * M[i * r + j];
+    sig[j] = sqrt(nn);
+    if (sig[j] > 0.0) for (int i = 0; i < r; i++) M[i * r + j] /= sig[j];
+  }
+
+  // sort columns by sig, descending (r is small: selection sort)
+  for (int a = 0; a < r; a++) {
+    int best = a;
+    for (int b = a + 1; b < r; b++) if (sig[b] > sig[best]) best = b;
+    if (best == a) continue;
+    double t = sig[a]; sig[a] = sig[best]; sig[best] = t;
+    for (int i = 0; i < r; i++) {
+      t = M[i * r + a]; M[i * r + a] = M[i * r + best]; M[i * r + best] = t;
+      t = V[i * r + a]; V[i * r + a] = V[i * r + best]; V[i * r + best] = t;
+    }
+  }
+}
+
+int lora_compact(LoRA* L, float energy) {
+  if (!L) return 0;
+  const int r = L->rank, in_dim = L->in_dim, out_dim = L->out_dim;
+  double e = LORA_CLAMP((double)energy, 0.0, 1.0);
+
+  float* QA = fcalloc((size_t)r * (size_t)in_dim);
+  float* QB = fcalloc((size_t)r * (size_t)out_dim);
+  double* small = (double*)calloc((size_t)r * (size_t)r * 4 + (size_t)r, sizeof(double));
+  if (!QA || !QB || !small) { free(QA); free(QB); free(small); return r; }
+  double* RA = small;
+  double* RB = RA + r * r;
+  double* M = RB + r * r;
+  double* V = M + r * r;
+  double* sig = V + r * r;
+
+  // Q_A from A's columns (= stored rows), Q_B from Bᵀ's columns (strided in B)
+  memcpy(QA, L->A, (size_t)r * (size_t)in_dim * sizeof(float));
+  for (int s = 0; s < r; s++)
+    for (int j = 0; j < out_dim; j++)
+      QB[(size_t)s * (size_t)out_dim + (size_t)j] = L->B[(size_t)j * (size_t)r + (size_t)s];
+  lora_mgs(QA, in_dim, r, RA);
+  lora_mgs(QB, out_dim, r, RB);
+
+  // core = R_A · R_Bᵀ
+  for (int p = 0; p < r; p++)
+    for (int q = 0; q < r; q++) {
+      double acc = 0.0;
+      for (int t = 0; t < r; t++) acc += RA[p * r + t] * RB[q * r + t];
+      M[p * r + q] = acc;
+    }
+  lora_jacobi_svd(M, V, sig, r);
+
+  double total = 0.0;
+  for (int t = 0; t < r; t++) total += sig[t] * sig[t];
+  if (!(total > 0.0)) { free(QA); free(QB); free(small); return r; }  // zero delta
+
+  int k = 0;
+  double kept = 0.0;
+  while (k < r && (k == 0 || kept < e * total * (1.0 - 1e-12))) { kept += sig[k] * sig[k]; k++; }
+  while (k > 1 && sig[k - 1] <= 1e-12 * sig[0]) k--;  // numerically zero tail
+
+  float* nA = fcalloc((size_t)k * (size_t)in_dim);
+  float* nB = fcalloc((size_t)out_dim * (size_t)k);
+  if (!nA || !nB) { free(nA); free(nB); free(QA); free(QB); free(small); return r; }
+
+  // delta = (alpha/r)·c²·Σ σ_t a_t b_tᵀ = (alpha/k)·Σ (f_t a_t)(f_t b_t)ᵀ
+  const double c2 = (double)L->fscale * (double)L->fscale;
+  for (int t = 0; t < k; t++) {
+    double f = sqrt(sig[t] * c2 * (double)k / (double)r);
+    float* a = nA + (size_t)t * (size_t)in_dim;
+    for (int i = 0; i < in_dim; i++) {
+      double acc = 0.0;
+      for (int s2 = 0; s2 < r; s2++) acc += (double)QA[(size_t)s2 * (size_t)in_dim + (size_t)i] * M[s2 * r + t];
+      a[i] = (float)(acc * f);
+    }
+  }
+  for (int j = 0; j < out_dim; j++) {
+    for (int t = 0; t < k; t++) {
+      double f = sqrt(sig[t] * c2 * (double)k / (double)r);
+      double acc = 0.0;
+      for (int s2 = 0; s2 < r; s2++) acc += (double)QB[(size_t)s2 * (size_t)out_dim + (size_t)j] * V[s2 * r + t];
+      nB[(size_t)j * (size_t)k + (size_t)t] = (float)(acc * f);
+    }
+  }
+
+  free(QA); free(QB); free(small);
+
+  if (L->map) lora_unmap(L);
+  else { free(L->A); free(L->B); }
+  L->A = nA;
+  L->B = nB;
+  // shrinking scratch: on the (unlikely) failure the larger buffer still fits
+  float* p;
+  if ((p = (float*)realloc(L->u, (size_t)k * sizeof(float)))) L->u = p;
+  if ((p = (float*)realloc(L->Ax, (size_t)k * sizeof(float)))) L->Ax = p;
+  if ((p = (float*)realloc(L->XA, (size_t)LORA_BATCH_ROWS * (size_t)k * sizeof(float)))) L->XA = p;
+
+  L->rank = k;
+  L->fscale = 1.0f;
+  L->dirty = 1;
+  lora_pick_kernel(L);
+  lora_norms_exact(L);
+  return k;
+}
+
+// Memory footprint of one adapter (factors + scratch + struct)
+size_t lora_get_bytes(const LoRA* L) {
+  if (!L) return 0;
+  size_t floats = (size_t)L->in_dim * (size_t)L->rank      // A
+                + (size_t)L->rank * (size_t)L->out_dim     // B
+                + (size_t)L->out_dim                       // dy
+                + (size_t)L->rank * (2 + LORA_BATCH_ROWS); // u, Ax, XA
+  return sizeof(LoRA) + floats * sizeof(float);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// Adapter Pool — many adapters resident, one batched call
+//
+// Adapters (per user, per mood, ...) share in_dim/out_dim; rank may differ.
+// Each is registered under an integer id (>= 0). The pool owns them:
+//   - id -> slot is an open-addressing hash (O(1) lookup per row)
+//   - slots sit on an intrusive LRU list (head = most recent)
+//   - adding past budget_bytes evicts from the LRU tail (lora_free)
+// lora_pool_apply_batch(P, X, Y, ids, n) groups rows by adapter and runs
+// each group through the blocked batch core, so every adapter's A/B is
+// streamed once per call no matter how rows are interleaved.
+//
+// A LoRA* from lora_pool_get stays valid until the next add/remove that
+// evicts it. Sizes are recorded at add time: after changing a pooled
+// adapter's rank (lora_compact), re-add it under the same id so the pool
+// re-accounts its bytes.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  int id;          // -1 = free slot
+  int prev, next;  // LRU list (slot indices, -1 = none); next doubles as free list
+  LoRA* L;
+  size_t bytes;
+} LoRAPoolEntry;
+
+typedef struct {
+  int in_dim, out_dim;
+  size_t budget;   // bytes, 0 = unlimited
+  size_t used;
+
+  LoRAPoolEntry* e;
+  int cap, count;
+  int head, tail;  // most / least recently used
+  int free_head;
+
+  int* hash;       // slot index or -1, hcap is a power of two
+  int hcap;
+
+  int* order;      // apply scratch: (slot, row) pairs
+  int order_cap;
+} LoRAPool;
+
+static uint32_t lora_pool_home(const LoRAPool* P, int id) {
+  return ((uint32_t)id * 2654435761u) & (uint32_t)(P->hcap - 1);
+}
+
+static int lora_pool_find(const LoRAPool* P, int id, int* pos_out) {
+  uint32_t mask = (uint32_t)(P->hcap - 1);
+  for (uint32_t i = lora_pool_home(P, id); ; i = (i + 1) & mask) {
+    int slot = P->hash[i];
+    if (slot < 0) { if (pos_out) *pos_out = (int)i; return -1; }
+    if (P->e[slot].id == id) { if (pos_out) *pos_out = (int)i; return slot; }
+  }
+}
+
+static int lora_pool_rehash(LoRAPool* P, int hcap) {
+  int* h = (int*)malloc((size_t)hcap * sizeof(int));
+  if (!h) return 1;
+  for (int i = 0; i < hcap; i++) h[i] = -1;
+  free(P->hash);
+  P->hash = h;
+  P->hcap = hcap;
+  for (int slot = 0; slot < P->cap; slot++) {
+    if (P->e[slot].id < 0) continue;
+    int pos;
+    lora_pool_find(P, P->e[slot].id, &pos);
+    P->hash[pos] = slot;
+  }
+  return 0;
+}
+
+// backward-shift delete: keeps probe chains intact without tombstones
+static void lora_pool_hash_delete(LoRAPool* P, int pos) {
+  uint32_t mask = (uint32_t)(P->hcap - 1);
+  uint32_t i = (uint32_t)pos, j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    int slot = P->hash[j];
+    if (slot < 0) break;
+    uint32_t k = lora_pool_home(P, P->e[slot].id);
+    // move j back into the hole at i if its home does not lie in (i, j]
+    if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+      P->hash[i] = slot;
+      i = j;
+    }
+  }
+  P->hash[i] = -1;
+}
+
+static void lora_pool_unlink(LoRAPool* P, int slot) {
+  LoRAPoolEntry* x = &P->e[slot];
+  if (x->prev >= 0) P->e[x->prev].next = x->next; else P->head = x->next;
+  if (x->next >= 0) P->e[x->next].prev = x->prev; else P->tail = x->prev;
+  x->prev = x->next = -1;
+}
+
+static void lora_pool_push_front(LoRAPool* P, int slot) {
+  LoRAPoolEntry* x = &P->e[slot];
+  x->prev = -1;
+  x->next = P->head;
+  if (P->head >= 0) P->e[P->head].prev = slot;
+  P->head = slot;
+  if (P->tail < 0) P->tail = slot;
+}
+
+static void lora_pool_touch(LoRAPool* P, int slot) {
+  if (P->head == slot) return;
+  lora_pool_unlink(P, slot);
+  lora_pool_push_front(P, slot);
+}
+
+static void lora_pool_drop(LoRAPool* P, int slot, int pos) {
+  LoRAPoolEntry* x = &P->e[slot];
+  lora_pool_hash_delete(P, pos);
+  lora_pool_unlink(P, slot);
+  lora_free(x->L);
+  P->used -= x->bytes;
+  P->count--;
+  x->id = -1;
+  x->L = NULL;
+  x->bytes = 0;
+  x->next = P->free_head;
+  P->free_head = slot;
+}
+
+LoRAPool* lora_pool_new(int in_dim, int out_dim, size_t budget_bytes) {
+  if (in_dim <= 0 || out_dim <= 0) return NULL;
+  LoRAPool* P = (LoRAPool*)calloc(1, sizeof(LoRAPool));
+  if (!P) return NULL;
+  P->in_dim = in_dim;
+  P->out_dim = out_dim;
+  P->budget = budget_bytes;
+  P->head = P->tail = P->free_head = -1;
+  if (lora_pool_rehash(P, 16)) { free(P); return NULL; }
+  return P;
+}
+
+void lora_pool_free(LoRAPool* P) {
+  if (!P) return;
+  for (int slot = 0; slot < P->cap; slot++) lora_free(P->e[slot].L);
+  free(P->e);
+  free(P->hash);
+  free(P->order);
+  free(P);
+}
+
+int lora_pool_evict_lru(LoRAPool* P) {
+  if (!P || P->tail < 0) return -1;
+  int slot = P->tail, pos;
+  int id = P->e[slot].id;
+  lora_pool_find(P, id, &pos);
+  lora_pool_drop(P, slot, pos);
+  return id;
+}
+
+// Register L under id (replacing any adapter already there); the pool takes
+// ownership. Evicts least recently used adapters to stay within budget.
+// Returns 0 on success, 1 on error (bad id/shape, over budget on its own,
+// OOM) — then the caller keeps L and the pool is unchanged: storage is
+// grown before anything is replaced or evicted.
+int lora_pool_add(LoRAPool* P, int id, LoRA* L) {
+  if (!P || !L || id < 0) return 1;
+  if (L->in_dim != P->in_dim || L->out_dim != P->out_dim) return 1;
+  size_t bytes = lora_get_bytes(L);
+  if (P->budget && bytes > P->budget) return 1;
+
+  int old = lora_pool_find(P, id, NULL);
+  if (old >= 0 && P->e[old].L == L) {
+    // already resident: refresh its size (it may have been compacted)
+    lora_pool_touch(P, old);
+    P->used = P->used - P->e[old].bytes + bytes;
+    P->e[old].bytes = bytes;
+    while (P->budget && P->used > P->budget && P->tail != old) lora_pool_evict_lru(P);
+    return 0;
+  }
+
+  // grow slot array / hash as needed
+  if (P->free_head < 0) {
+    int ncap = P->cap ? P->cap * 2 : 8;
+    LoRAPoolEntry* ne = (LoRAPoolEntry*)realloc(P->e, (size_t)ncap * sizeof(LoRAPoolEntry));
+    if (!ne) return 1;
+    P->e = ne;
+    for (int slot = ncap - 1; slot >= P->cap; slot--) {
+      ne[slot].id = -1; ne[slot].L = NULL; ne[slot].bytes = 0; ne[slot].prev = -1;
+      ne[slot].next = P->free_head;
+      P->free_head = slot;
+    }
+    P->cap = ncap;
+  }
+  if ((P->count + 1) * 2 > P->hcap && lora_pool_rehash(P, P->hcap * 2)) return 1;
+
+  int pos;
+  old = lora_pool_find(P, id, &pos);
+  if (old >= 0) lora_pool_drop(P, old, pos);
+  while (P->budget && P->used + bytes > P->budget && P->tail >= 0) lora_pool_evict_lru(P);
+
+  int slot = P->free_head;
+  P->free_head = P->e[slot].next;
+  P->e[slot].id = id;
+  P->e[slot].L = L;
+  P->e[slot].bytes = bytes;
+  lora_pool_find(P, id, &pos);
+  P->hash[pos] = slot;
+  lora_pool_push_front(P, slot);
+  P->used += bytes;
+  P->count++;
+  return 0;
+}
+
+// Look up (and mark as recently used); NULL if absent or evicted
+LoRA* lora_pool_get(LoRAPool* P, int id) {
+  if (!P || id < 0) return NULL;
+  int slot = lora_pool_find(P, id, NULL);
+  if (slot < 0) return NULL;
+  lora_pool_touch(P, slot);
+  return P->e[slot].L;
+}
+
+int lora_pool_remove(LoRAPool* P, int id) {
+  if (!P || id < 0) return 1;
+  int pos;
+  int slot = lora_pool_find(P, id, &pos);
+  if (slot < 0) return 1;
+  lora_pool_drop(P, slot, pos);
+  return 0;
+}
+
+int lora_pool_count(const LoRAPool* P) { return P ? P->count : 0; }
+size_t lora_pool_bytes(const LoRAPool* P) { return P ? P->used : 0; }
+
+static int lora_pool_pair_cmp(const void* a, const void* b) {
+  const int* x = (const int*)a;
+  const int* y = (const int*)b;
+  if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+  return x[1] < y[1] ? -1 : (x[1] > y[1]);
+}
+
+// Y[b] += adapter(ids[b]) applied to X[b], for n rows. Rows whose id is
+// negative or not resident are left untouched (base model only).
+// Returns the number of rows that got an adapter.
+int lora_pool_apply_batch(LoRAPool* P, const float* X, float* Y, const int* ids, int n) {
+  if (!P || !X || !Y || !ids || n <= 0) return 0;
+
+  if (n > P->order_cap) {
+    int* o = (int*)realloc(P->order, (size_t)n * 2 * sizeof(int));
+    if (!o) return 0;
+    P->order = o;
+    P->order_cap = n;
+  }
+
+  // resolve ids once, then sort (slot, row) so each adapter's rows are adjacent
+  int m = 0;
+  for (int b = 0; b < n; b++) {
+    int slot = ids[b] >= 0 ? lora_pool_find(P, ids[b], NULL) : -1;
+    if (slot < 0) continue;
+    P->order[2 * m] = slot;
+    P->order[2 * m + 1] = b;
+    m++;
+  }
+  if (m > 1) qsort(P->order, (size_t)m, 2 * sizeof(int), lora_pool_pair_cmp);
+
+  // compact rows in place: order[0..m) becomes the row list (writing rows[k]
+  // only clobbers pair k/2, which has already been read)
+  int* rows = P->order;
+  int start = 0;
+  while (start < m) {
+    int slot = P->order[2 * start];
+    int end = start;
+    while (end < m && P->order[2 * end] == slot) {
+      rows[end] = P->order[2 * end + 1];
+      end++;
     }
-    y[j] += s * scaling;
+    lora_pool_touch(P, slot);
+    lora_apply_rows(P->e[slot].L, X, Y, rows + start, end - start);
+    start = end;
   }
+  return m;
 }
 
 #ifdef __cplusplus